@@ -260,6 +260,7 @@ typedef enum {
   VTERM_PROP_CURSORSHAPE,       // number
   VTERM_PROP_MOUSE,             // number
   VTERM_PROP_FOCUSREPORT,       // bool
+  VTERM_PROP_SYNCUPDATE,        // bool
 
   VTERM_N_PROPS
 } VTermProp;
@@ -437,6 +438,8 @@ typedef struct {
   int (*resize)(int rows, int cols, VTermStateFields *fields, void *user);
   int (*setlineinfo)(int row, const VTermLineInfo *newinfo, const VTermLineInfo *oldinfo, void *user);
   int (*sb_clear)(void *user);
+  // ABI-compat this is only used if vterm_state_callbacks_has_premove() is called
+  int (*premove)(VTermRect dest, void *user);
 } VTermStateCallbacks;
 
 typedef struct {
@@ -457,6 +460,7 @@ typedef struct {
 VTermState *vterm_obtain_state(VTerm *vt);
 
 void  vterm_state_set_callbacks(VTermState *state, const VTermStateCallbacks *callbacks, void *user);
+void  vterm_state_callbacks_has_premove(VTermState *state);
 void *vterm_state_get_cbdata(VTermState *state);
 
 void  vterm_state_set_unrecognised_fallbacks(VTermState *state, const VTermStateFallbacks *fallbacks, void *user);
@@ -541,11 +545,15 @@ typedef struct {
   int (*sb_pushline)(int cols, const VTermScreenCell *cells, void *user);
   int (*sb_popline)(int cols, VTermScreenCell *cells, void *user);
   int (*sb_clear)(void* user);
+  // ABI-compat these are only used if vterm_screen_callbacks_has_pushline4() is called
+  int (*sb_pushline4)(int cols, const VTermScreenCell *cells, bool continuation, void *user);
+  int (*sb_popline4)(int cols, VTermScreenCell *cells, bool *continuation, void *user);
 } VTermScreenCallbacks;
 
 VTermScreen *vterm_obtain_screen(VTerm *vt);
 
 void  vterm_screen_set_callbacks(VTermScreen *screen, const VTermScreenCallbacks *callbacks, void *user);
+void  vterm_screen_callbacks_has_pushline4(VTermScreen *screen);
 void *vterm_screen_get_cbdata(VTermScreen *screen);
 
 void  vterm_screen_set_unrecognised_fallbacks(VTermScreen *screen, const VTermStateFallbacks *fallbacks, void *user);
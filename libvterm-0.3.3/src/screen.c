@@ -60,6 +60,7 @@ struct VTermScreen
 
   unsigned int global_reverse : 1;
   unsigned int reflow : 1;
+  unsigned int callbacks_has_pushline4 : 1;
 
   /* Primary and Altscreen. buffers[1] is lazily allocated as needed */
   ScreenCell *buffers[2];
@@ -70,6 +71,9 @@ struct VTermScreen
   /* buffer for a single screen row used in scrollback storage callbacks */
   VTermScreenCell *sb_buffer;
 
+  /* continuation flags of the rows about to scroll off into scrollback */
+  bool *sb_continuation;
+
   ScreenPen pen;
 };
 
@@ -205,25 +209,47 @@ static int putglyph(VTermGlyphInfo *info, VTermPos pos, void *user)
   return 1;
 }
 
-static void sb_pushline_from_row(VTermScreen *screen, int row)
+static bool has_sb_pushline(VTermScreen *screen)
+{
+  return screen->callbacks &&
+    (screen->callbacks->sb_pushline ||
+     (screen->callbacks_has_pushline4 && screen->callbacks->sb_pushline4));
+}
+
+static void sb_pushline_from_row(VTermScreen *screen, int row, bool continuation)
 {
   VTermPos pos = { .row = row };
   for(pos.col = 0; pos.col < screen->cols; pos.col++)
     vterm_screen_get_cell(screen, pos, screen->sb_buffer + pos.col);
 
-  (screen->callbacks->sb_pushline)(screen->cols, screen->sb_buffer, screen->cbdata);
+  if(screen->callbacks_has_pushline4 && screen->callbacks->sb_pushline4)
+    (screen->callbacks->sb_pushline4)(screen->cols, screen->sb_buffer, continuation, screen->cbdata);
+  else
+    (screen->callbacks->sb_pushline)(screen->cols, screen->sb_buffer, screen->cbdata);
+}
+
+static int premove(VTermRect rect, void *user)
+{
+  VTermScreen *screen = user;
+
+  /* The lineinfo of these rows is overwritten before they are moved, so
+   * remember their continuation flags for sb_pushline4 */
+  for(int row = rect.start_row; row < rect.end_row && row < screen->rows; row++)
+    screen->sb_continuation[row] = vterm_state_get_lineinfo(screen->state, row)->continuation;
+
+  return 1;
 }
 
 static int moverect_internal(VTermRect dest, VTermRect src, void *user)
 {
   VTermScreen *screen = user;
 
-  if(screen->callbacks && screen->callbacks->sb_pushline &&
+  if(has_sb_pushline(screen) &&
      dest.start_row == 0 && dest.start_col == 0 &&        // starts top-left corner
      dest.end_col == screen->cols &&                      // full width
      screen->buffer == screen->buffers[BUFIDX_PRIMARY]) { // not altscreen
     for(int row = 0; row < src.start_row; row++)
-      sb_pushline_from_row(screen, row);
+      sb_pushline_from_row(screen, row, screen->sb_continuation[row]);
   }
 
   int cols = src.end_col - src.start_col;
@@ -667,19 +693,28 @@ static void resize_buffer(VTermScreen *screen, int bufidx, int new_rows, int new
 
   if(old_row >= 0 && bufidx == BUFIDX_PRIMARY) {
     /* Push spare lines to scrollback buffer */
-    if(screen->callbacks && screen->callbacks->sb_pushline)
+    if(has_sb_pushline(screen))
       for(int row = 0; row <= old_row; row++)
-        sb_pushline_from_row(screen, row);
+        sb_pushline_from_row(screen, row, old_lineinfo && old_lineinfo[row].continuation);
     if(active)
       statefields->pos.row -= (old_row + 1);
   }
+  bool has_popline4 = screen->callbacks &&
+    screen->callbacks_has_pushline4 && screen->callbacks->sb_popline4;
   if(new_row >= 0 && bufidx == BUFIDX_PRIMARY &&
-      screen->callbacks && screen->callbacks->sb_popline) {
+      screen->callbacks && (screen->callbacks->sb_popline || has_popline4)) {
     /* Try to backfill rows by popping scrollback buffer */
     while(new_row >= 0) {
-      if(!(screen->callbacks->sb_popline(old_cols, screen->sb_buffer, screen->cbdata)))
+      bool continuation = false;
+      if(has_popline4) {
+        if(!(screen->callbacks->sb_popline4(old_cols, screen->sb_buffer, &continuation, screen->cbdata)))
+          break;
+      }
+      else if(!(screen->callbacks->sb_popline(old_cols, screen->sb_buffer, screen->cbdata)))
         break;
 
+      new_lineinfo[new_row] = (VTermLineInfo){ .continuation = continuation };
+
       VTermPos pos = { .row = new_row };
       for(pos.col = 0; pos.col < old_cols && pos.col < new_cols; pos.col += screen->sb_buffer[pos.col].width) {
         VTermScreenCell *src = &screen->sb_buffer[pos.col];
@@ -777,6 +812,11 @@ static int resize(int new_rows, int new_cols, VTermStateFields *fields, void *us
 
   screen->buffer = altscreen_active ? screen->buffers[BUFIDX_ALTSCREEN] : screen->buffers[BUFIDX_PRIMARY];
 
+  if(new_rows != old_rows) {
+    vterm_allocator_free(screen->vt, screen->sb_continuation);
+    screen->sb_continuation = vterm_allocator_malloc(screen->vt, sizeof(bool) * new_rows);
+  }
+
   screen->rows = new_rows;
   screen->cols = new_cols;
 
@@ -848,6 +888,7 @@ static VTermStateCallbacks state_cbs = {
   .resize      = &resize,
   .setlineinfo = &setlineinfo,
   .sb_clear    = &sb_clear,
+  .premove     = &premove,
 };
 
 static VTermScreen *screen_new(VTerm *vt)
@@ -873,6 +914,7 @@ static VTermScreen *screen_new(VTerm *vt)
 
   screen->global_reverse = false;
   screen->reflow = false;
+  screen->callbacks_has_pushline4 = false;
 
   screen->callbacks = NULL;
   screen->cbdata    = NULL;
@@ -882,8 +924,10 @@ static VTermScreen *screen_new(VTerm *vt)
   screen->buffer = screen->buffers[BUFIDX_PRIMARY];
 
   screen->sb_buffer = vterm_allocator_malloc(screen->vt, sizeof(VTermScreenCell) * cols);
+  screen->sb_continuation = vterm_allocator_malloc(screen->vt, sizeof(bool) * rows);
 
   vterm_state_set_callbacks(screen->state, &state_cbs, screen);
+  vterm_state_callbacks_has_premove(screen->state);
 
   return screen;
 }
@@ -895,6 +939,7 @@ INTERNAL void vterm_screen_free(VTermScreen *screen)
     vterm_allocator_free(screen->vt, screen->buffers[BUFIDX_ALTSCREEN]);
 
   vterm_allocator_free(screen->vt, screen->sb_buffer);
+  vterm_allocator_free(screen->vt, screen->sb_continuation);
 
   vterm_allocator_free(screen->vt, screen);
 }
@@ -1056,6 +1101,11 @@ void vterm_screen_set_callbacks(VTermScreen *screen, const VTermScreenCallbacks
   screen->cbdata = user;
 }
 
+void vterm_screen_callbacks_has_pushline4(VTermScreen *screen)
+{
+  screen->callbacks_has_pushline4 = true;
+}
+
 void *vterm_screen_get_cbdata(VTermScreen *screen)
 {
   return screen->cbdata;
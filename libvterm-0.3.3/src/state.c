@@ -73,6 +73,7 @@ static VTermState *vterm_state_new(VTerm *vt)
 
   state->callbacks = NULL;
   state->cbdata    = NULL;
+  state->callbacks_has_premove = false;
 
   state->selection.callbacks = NULL;
   state->selection.user      = NULL;
@@ -126,6 +127,15 @@ static void scroll(VTermState *state, VTermRect rect, int downward, int rightwar
   else if(rightward < -cols)
     rightward = -cols;
 
+  // Give the screen a chance to see the lines scrolling off the top before
+  // their lineinfo is overwritten; scrolling the whole area just erases it
+  if(state->callbacks_has_premove && state->callbacks && state->callbacks->premove &&
+     downward > 0 && downward < rows && rightward == 0) {
+    VTermRect src = rect;
+    src.end_row = rect.start_row + downward;
+    (*state->callbacks->premove)(src, state->cbdata);
+  }
+
   // Update lineinfo if full line
   if(rect.start_col == 0 && rect.end_col == state->cols && rightward == 0) {
     int height = rect.end_row - rect.start_row - abs(downward);
@@ -834,6 +844,10 @@ static void set_dec_mode(VTermState *state, int num, int val)
     state->mode.bracketpaste = val;
     break;
 
+  case 2026:
+    settermprop_bool(state, VTERM_PROP_SYNCUPDATE, val);
+    break;
+
   default:
     DEBUG_LOG("libvterm: Unknown DEC mode %d\n", num);
     return;
@@ -909,6 +923,10 @@ static void request_dec_mode(VTermState *state, int num)
       reply = state->mode.bracketpaste;
       break;
 
+    case 2026:
+      reply = state->mode.syncupdate;
+      break;
+
     default:
       vterm_push_output_sprintf_ctrl(state->vt, C1_CSI, "?%d;%d$y", num, 0);
       return;
@@ -2086,6 +2104,7 @@ void vterm_state_reset(VTermState *state, int hard)
   state->mode.leftrightmargin = 0;
   state->mode.bracketpaste    = 0;
   state->mode.report_focus    = 0;
+  state->mode.syncupdate      = 0;
 
   state->mouse_flags = 0;
 
@@ -2156,6 +2175,11 @@ void vterm_state_set_callbacks(VTermState *state, const VTermStateCallbacks *cal
   }
 }
 
+void vterm_state_callbacks_has_premove(VTermState *state)
+{
+  state->callbacks_has_premove = true;
+}
+
 void *vterm_state_get_cbdata(VTermState *state)
 {
   return state->cbdata;
@@ -2228,6 +2252,9 @@ int vterm_state_set_termprop(VTermState *state, VTermProp prop, VTermValue *val)
   case VTERM_PROP_FOCUSREPORT:
     state->mode.report_focus = val->boolean;
     return 1;
+  case VTERM_PROP_SYNCUPDATE:
+    state->mode.syncupdate = val->boolean;
+    return 1;
 
   case VTERM_N_PROPS:
     return 0;
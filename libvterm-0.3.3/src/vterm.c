@@ -141,6 +141,25 @@ void vterm_output_set_callback(VTerm *vt, VTermOutputCallback *func, void *user)
   vt->outdata = user;
 }
 
+#define OUTBUFFER_CHUNK 4096
+
+static bool grow_outbuffer(VTerm *vt, size_t len)
+{
+  size_t needed = vt->outbuffer_cur + len;
+  size_t newlen = (needed + OUTBUFFER_CHUNK - 1) / OUTBUFFER_CHUNK * OUTBUFFER_CHUNK;
+
+  char *newbuffer = vterm_allocator_malloc(vt, newlen);
+  if(!newbuffer)
+    return false;
+
+  memcpy(newbuffer, vt->outbuffer, vt->outbuffer_cur);
+  vterm_allocator_free(vt, vt->outbuffer);
+
+  vt->outbuffer = newbuffer;
+  vt->outbuffer_len = newlen;
+  return true;
+}
+
 INTERNAL void vterm_push_output_bytes(VTerm *vt, const char *bytes, size_t len)
 {
   if(vt->outfunc) {
@@ -148,8 +167,12 @@ INTERNAL void vterm_push_output_bytes(VTerm *vt, const char *bytes, size_t len)
     return;
   }
 
-  if(len > vt->outbuffer_len - vt->outbuffer_cur)
+  /* Grow the buffer in chunks rather than losing output the embedding
+   * application has not read yet */
+  if(len > vt->outbuffer_len - vt->outbuffer_cur && !grow_outbuffer(vt, len)) {
+    DEBUG_LOG("vterm_push_output_bytes(): buffer overflow; dropping output\n");
     return;
+  }
 
   memcpy(vt->outbuffer + vt->outbuffer_cur, bytes, len);
   vt->outbuffer_cur += len;
@@ -157,10 +180,25 @@ INTERNAL void vterm_push_output_bytes(VTerm *vt, const char *bytes, size_t len)
 
 INTERNAL void vterm_push_output_vsprintf(VTerm *vt, const char *format, va_list args)
 {
+  va_list args_copy;
+  va_copy(args_copy, args);
+
   size_t len = vsnprintf(vt->tmpbuffer, vt->tmpbuffer_len,
       format, args);
 
-  vterm_push_output_bytes(vt, vt->tmpbuffer, len);
+  if(len < vt->tmpbuffer_len)
+    vterm_push_output_bytes(vt, vt->tmpbuffer, len);
+  else {
+    /* Too large for the scratch buffer; format it into a one-off buffer */
+    char *buffer = vterm_allocator_malloc(vt, len + 1);
+    if(buffer) {
+      vsnprintf(buffer, len + 1, format, args_copy);
+      vterm_push_output_bytes(vt, buffer, len);
+      vterm_allocator_free(vt, buffer);
+    }
+  }
+
+  va_end(args_copy);
 }
 
 INTERNAL void vterm_push_output_sprintf(VTerm *vt, const char *format, ...)
@@ -296,6 +334,7 @@ VTermValueType vterm_get_prop_type(VTermProp prop)
     case VTERM_PROP_CURSORSHAPE:   return VTERM_VALUETYPE_INT;
     case VTERM_PROP_MOUSE:         return VTERM_VALUETYPE_INT;
     case VTERM_PROP_FOCUSREPORT:   return VTERM_VALUETYPE_BOOL;
+    case VTERM_PROP_SYNCUPDATE:    return VTERM_VALUETYPE_BOOL;
 
     case VTERM_N_PROPS: return 0;
   }
@@ -58,6 +58,7 @@ struct VTermState
 
   const VTermStateCallbacks *callbacks;
   void *cbdata;
+  bool callbacks_has_premove;
 
   const VTermStateFallbacks *fallbacks;
   void *fbdata;
@@ -120,6 +121,7 @@ struct VTermState
     unsigned int leftrightmargin:1;
     unsigned int bracketpaste:1;
     unsigned int report_focus:1;
+    unsigned int syncupdate:1;
   } mode;
 
   VTermEncodingInstance encoding[4], encoding_utf8;
@@ -569,7 +569,7 @@ static int screen_damage(VTermRect rect, void *user)
 }
 
 static int want_screen_scrollback = 0;
-static int screen_sb_pushline(int cols, const VTermScreenCell *cells, void *user)
+static int screen_sb_pushline4(int cols, const VTermScreenCell *cells, bool continuation, void *user)
 {
   if(!want_screen_scrollback)
     return 1;
@@ -578,7 +578,7 @@ static int screen_sb_pushline(int cols, const VTermScreenCell *cells, void *user
   while(eol && !cells[eol-1].chars[0])
     eol--;
 
-  printf("sb_pushline %d =", cols);
+  printf("sb_pushline %d%s =", cols, continuation ? " cont" : "");
   for(int c = 0; c < eol; c++)
     printf(" %02X", cells[c].chars[0]);
   printf("\n");
@@ -619,9 +619,9 @@ VTermScreenCallbacks screen_cbs = {
   .moverect    = moverect,
   .movecursor  = movecursor,
   .settermprop = settermprop,
-  .sb_pushline = screen_sb_pushline,
   .sb_popline  = screen_sb_popline,
   .sb_clear    = screen_sb_clear,
+  .sb_pushline4 = screen_sb_pushline4,
 };
 
 int main(int argc, char **argv)
@@ -708,6 +708,7 @@ int main(int argc, char **argv)
       if(!screen)
         screen = vterm_obtain_screen(vt);
       vterm_screen_set_callbacks(screen, &screen_cbs, NULL);
+      vterm_screen_callbacks_has_pushline4(screen);
 
       int i = 10;
       int sense = 1;
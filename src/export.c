@@ -0,0 +1,285 @@
+#include <SDL2/SDL.h>
+#include <iso646.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "export.h"
+
+#define EXPORT_BUFFER 65536
+
+struct Export {
+    SDL_Thread  *thread;
+    SDL_atomic_t done;
+    Uint32       event;
+
+    enum ExportFormat format;
+    VTermScreenCell   blank;
+    VTermScreenCell   pen;    /* attributes in effect in the written line */
+    SDL_bool          styled; /* the pen was changed in the line */
+
+    int      fd;
+    SDL_bool failed;
+    size_t   lines;
+    size_t   length;
+    char     buffer[EXPORT_BUFFER];
+
+    /* Scrollback lines are decoded into cells one at a time */
+    struct HistorySnapshot *snapshot;
+    VTermScreenCell *cells;
+    int capacity;
+
+    /* Copy of the screen */
+    VTermScreenCell *screen;
+    SDL_bool *continuation;
+    int rows;
+    int cols;
+};
+
+/**
+ * Writes out the buffered output
+ */
+static void export_flush(struct Export *export) {
+    for (size_t written = 0; not export->failed and written < export->length;) {
+        ssize_t result = write(export->fd, export->buffer + written, export->length - written);
+        export->failed = result <= 0;
+        written += export->failed ? 0 : result;
+    }
+    export->length = 0;
+}
+
+static void export_write(struct Export *export, const char *data, size_t length) {
+    if (export->length + length > sizeof(export->buffer)) {
+        export_flush(export);
+    }
+    SDL_memcpy(export->buffer + export->length, data, length);
+    export->length += length;
+}
+
+static void export_char(struct Export *export, Uint32 c) {
+    char bytes[4];
+    export_write(export, bytes, history_encode_char(c, bytes));
+}
+
+/**
+ * Appends the SGR parameters selecting a color, resetting it to the default
+ * color if it is one
+ */
+static int export_color(const VTermColor *color, SDL_bool fg, int *sgr, int count) {
+    if (fg and VTERM_COLOR_IS_DEFAULT_FG(color)) {
+        sgr[count++] = 39;
+    } else if (not fg and VTERM_COLOR_IS_DEFAULT_BG(color)) {
+        sgr[count++] = 49;
+    } else if (VTERM_COLOR_IS_INDEXED(color) and color->indexed.idx < 8) {
+        sgr[count++] = color->indexed.idx + (fg ? 30 : 40);
+    } else if (VTERM_COLOR_IS_INDEXED(color) and color->indexed.idx < 16) {
+        sgr[count++] = color->indexed.idx - 8 + (fg ? 90 : 100);
+    } else if (VTERM_COLOR_IS_INDEXED(color)) {
+        sgr[count++] = fg ? 38 : 48;
+        sgr[count++] = 5;
+        sgr[count++] = color->indexed.idx;
+    } else {
+        sgr[count++] = fg ? 38 : 48;
+        sgr[count++] = 2;
+        sgr[count++] = color->rgb.red;
+        sgr[count++] = color->rgb.green;
+        sgr[count++] = color->rgb.blue;
+    }
+    return count;
+}
+
+/**
+ * Writes the SGR sequence changing the pen of the line to the attributes
+ * and colors of the cell, like unterm -f sgr does
+ */
+static void export_pen(struct Export *export, const VTermScreenCell *cell) {
+    const VTermScreenCellAttrs *from = &export->pen.attrs, *to = &cell->attrs;
+    int sgr[9 + 2 * 5];
+    int count = 0;
+    if (from->bold != to->bold) {
+        sgr[count++] = to->bold ? 1 : 22;
+    }
+    if (from->underline != to->underline) {
+        sgr[count++] = to->underline ? 4 : 24;
+    }
+    if (from->italic != to->italic) {
+        sgr[count++] = to->italic ? 3 : 23;
+    }
+    if (from->blink != to->blink) {
+        sgr[count++] = to->blink ? 5 : 25;
+    }
+    if (from->reverse != to->reverse) {
+        sgr[count++] = to->reverse ? 7 : 27;
+    }
+    if (from->conceal != to->conceal) {
+        sgr[count++] = to->conceal ? 8 : 28;
+    }
+    if (from->strike != to->strike) {
+        sgr[count++] = to->strike ? 9 : 29;
+    }
+    if (from->font != to->font) {
+        sgr[count++] = 10 + to->font;
+    }
+    if (not vterm_color_is_equal(&export->pen.fg, &cell->fg)) {
+        count = export_color(&cell->fg, SDL_TRUE, sgr, count);
+    }
+    if (not vterm_color_is_equal(&export->pen.bg, &cell->bg)) {
+        count = export_color(&cell->bg, SDL_FALSE, sgr, count);
+    }
+    if (count == 0) {
+        return;
+    }
+    char sequence[sizeof(sgr) / sizeof(*sgr) * 4 + 3] = "\x1b[";
+    size_t length = 2;
+    for (int i = 0; i < count; i++) {
+        length += SDL_snprintf(sequence + length, sizeof(sequence) - length, i ? ";%d" : "%d", sgr[i]);
+    }
+    sequence[length++] = 'm';
+    export_write(export, sequence, length);
+    export->pen = *cell;
+    export->styled = SDL_TRUE;
+}
+
+/**
+ * Writes cells to the current line. Blank cells are written as spaces, the
+ * second halves of wide characters are skipped.
+ */
+static void export_cells(struct Export *export, const VTermScreenCell *cells, int count) {
+    for (int col = 0; col < count; col++) {
+        const VTermScreenCell *cell = &cells[col];
+        if (cell->chars[0] == (uint32_t)-1) {
+            continue;
+        } else if (export->format == EXPORT_SGR) {
+            export_pen(export, cell);
+        }
+        if (cell->chars[0] == 0) {
+            export_char(export, ' ');
+        }
+        for (int i = 0; i < VTERM_MAX_CHARS_PER_CELL and cell->chars[i] != 0; i++) {
+            export_char(export, cell->chars[i]);
+        }
+    }
+}
+
+/**
+ * Ends the current line, resetting the pen if it changed
+ */
+static void export_end_line(struct Export *export) {
+    if (export->styled) {
+        export_write(export, "\x1b[m", 3);
+        export->pen = export->blank;
+        export->styled = SDL_FALSE;
+    }
+    export_write(export, "\n", 1);
+    export->lines++;
+}
+
+/**
+ * Returns the number of cells of the screen row without trailing blanks
+ */
+static int export_trim(const struct Export *export, int row) {
+    const VTermScreenCell *cells = &export->screen[row * export->cols];
+    int count = export->cols;
+    while (count > 0 and history_blank_cell(&cells[count - 1])) {
+        count--;
+    }
+    return count;
+}
+
+/**
+ * Export thread: writes the scrollback lines, then the screen rows up to the
+ * last one that is not blank
+ */
+static int export_run(void *data) {
+    struct Export *export = data;
+    SDL_bool pending = SDL_FALSE;
+    const struct HistoryLine *line;
+    while (not export->failed and (line = history_snapshot_next(export->snapshot)) != NULL) {
+        int cells = history_line_cells(line);
+        if (export->capacity < cells) {
+            export->capacity = cells;
+            export->cells = SDL_realloc(export->cells, sizeof(*export->cells) * cells);
+        }
+        history_decode_line(line, export->cells, cells, &export->blank);
+        if (pending) {
+            export_end_line(export);
+        }
+        export_cells(export, export->cells, cells);
+        pending = SDL_TRUE;
+    }
+    int rows = export->rows;
+    while (rows > 0 and export_trim(export, rows - 1) == 0) {
+        rows--;
+    }
+    for (int row = 0; row < rows; row++) {
+        if (pending and not export->continuation[row]) {
+            export_end_line(export);
+        }
+        /* Blanks at the end of a row are only kept if the line goes on */
+        SDL_bool wrapped = row + 1 < rows and export->continuation[row + 1];
+        int count = wrapped ? export->cols : export_trim(export, row);
+        export_cells(export, &export->screen[row * export->cols], count);
+        pending = SDL_TRUE;
+    }
+    if (pending) {
+        export_end_line(export);
+    }
+    export_flush(export);
+    SDL_AtomicSet(&export->done, 1);
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = export->event;
+    SDL_PushEvent(&event);
+    return 0;
+}
+
+struct Export* export_create(const char *path, enum ExportFormat format, const VTermScreenCell *blank) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        SDL_Log("Failed to create export file %s", path);
+        return NULL;
+    }
+    struct Export *export = SDL_calloc(1, sizeof(*export));
+    export->fd = fd;
+    export->format = format;
+    export->blank = *blank;
+    export->pen = *blank;
+    return export;
+}
+
+void export_add_row(struct Export *export, const VTermScreenCell *cells, int cols, SDL_bool continuation) {
+    export->cols = cols;
+    export->screen = SDL_realloc(export->screen, sizeof(*export->screen) * cols * (export->rows + 1));
+    export->continuation = SDL_realloc(export->continuation, sizeof(*export->continuation) * (export->rows + 1));
+    SDL_memcpy(&export->screen[export->rows * cols], cells, sizeof(*cells) * cols);
+    export->continuation[export->rows++] = continuation;
+}
+
+void export_start(struct Export *export, struct HistorySnapshot *snapshot, Uint32 event) {
+    export->snapshot = snapshot;
+    export->event = event;
+    export->thread = SDL_CreateThread(export_run, "export", export);
+    if (export->thread == NULL) {
+        SDL_Log("Failed to start export thread, exporting right away: %s", SDL_GetError());
+        export_run(export);
+    }
+}
+
+SDL_bool export_done(struct Export *export) {
+    return SDL_AtomicGet(&export->done);
+}
+
+SDL_bool export_finish(struct Export *export, size_t *lines) {
+    if (export->thread != NULL) {
+        SDL_WaitThread(export->thread, NULL);
+    }
+    SDL_bool failed = export->failed or close(export->fd) != 0;
+    if (export->failed) {
+        close(export->fd);
+    }
+    *lines = export->lines;
+    history_snapshot_free(export->snapshot);
+    SDL_free(export->cells);
+    SDL_free(export->screen);
+    SDL_free(export->continuation);
+    SDL_free(export);
+    return not failed;
+}
@@ -0,0 +1,55 @@
+#ifndef SDLTERM_EXPORT_H
+#define SDLTERM_EXPORT_H
+
+#include <SDL2/SDL.h>
+#include <vterm.h>
+#include "history.h"
+
+/**
+ * Output formats of an export: plain UTF-8 text, or text with SGR escape
+ * sequences reproducing the attributes and colors of the cells
+ */
+enum ExportFormat {
+    EXPORT_PLAIN,
+    EXPORT_SGR
+};
+
+/**
+ * Writes a snapshot of the scrollback buffer followed by a copy of the
+ * screen to a file on a background thread. Lines are written unwrapped,
+ * screen rows continuing the line above are joined to it.
+ */
+struct Export;
+
+/**
+ * Creates the file at the given path and prepares an export into it. Cells
+ * equal to the blank cell are written without attributes. Returns NULL if
+ * the file cannot be created.
+ */
+extern struct Export* export_create(const char *path, enum ExportFormat format, const VTermScreenCell *blank);
+
+/**
+ * Copies a screen row to be written after the scrollback buffer. All rows
+ * must be of the same width.
+ */
+extern void export_add_row(struct Export *export, const VTermScreenCell *cells, int cols, SDL_bool continuation);
+
+/**
+ * Starts writing the snapshot and the screen rows, handing the snapshot over
+ * to the export. An SDL event of the given type is pushed once done.
+ */
+extern void export_start(struct Export *export, struct HistorySnapshot *snapshot, Uint32 event);
+
+/**
+ * Returns SDL_TRUE once the export is done writing
+ */
+extern SDL_bool export_done(struct Export *export);
+
+/**
+ * Waits for the export to finish and frees it along with its snapshot, so
+ * this must be called on the thread owning the scrollback buffer. Stores the
+ * number of lines written and returns SDL_FALSE if writing failed.
+ */
+extern SDL_bool export_finish(struct Export *export, size_t *lines);
+
+#endif /* SDLTERM_EXPORT_H */
@@ -0,0 +1,1319 @@
+#define _GNU_SOURCE
+#include <SDL2/SDL.h>
+#include <iso646.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+#include "history.h"
+#include "lz.h"
+
+/* Lines are indexed in blocks: the index records where the first line of
+ * each block starts, the others are found by stepping over their
+ * predecessors. Index entries are allocated in chunks, so growing the
+ * buffer never copies more than the chunk table. */
+#define HISTORY_BLOCK 64
+#define HISTORY_CHUNK 1024
+
+/* Each block also carries a bloom filter of the byte pairs occurring in the
+ * text of its lines. A search skips every block lacking one of the pairs of
+ * the search text without looking at its lines. */
+#define HISTORY_FILTER 2048
+
+/* Rows pushed as the continuation of the newest line are appended to it, so
+ * that lines are stored unwrapped, up to this many cells */
+#define HISTORY_LINE_CELLS 8192
+
+/* Encoded lines are bump-allocated from slabs of this size */
+#define HISTORY_SLAB (1 << 20)
+#define HISTORY_ALIGN 8
+
+/* Sealed slabs are compressed in the background. Once more than
+ * HISTORY_RESIDENT bytes of slabs are held in memory, the oldest ones are
+ * spilled to a temporary file. Slabs that are compressed or spilled are
+ * decompressed or mapped on access into a small cache. */
+#define HISTORY_RESIDENT (8 << 20)
+#define HISTORY_CACHE 4
+
+/**
+ * A span of consecutive cells sharing pen, width and number of characters
+ */
+struct HistoryRun {
+    Uint32     attrs;
+    VTermColor fg;
+    VTermColor bg;
+    Uint16     span;
+    Uint8      chars; /* per cell, 0 for the second half of a wide character */
+    Uint8      width;
+};
+
+/**
+ * Encoded line header, followed by the runs and the text
+ */
+struct HistoryLine {
+    Uint16 cells;
+    Uint16 runs;
+    Uint32 text;
+};
+
+/**
+ * Position of an encoded line: the number of its slab and its offset within
+ */
+struct HistoryPosition {
+    size_t slab;
+    size_t offset;
+};
+
+/**
+ * Index entry of a block: where its first line starts and which byte pairs
+ * its lines contain
+ */
+struct HistoryBlock {
+    struct HistoryPosition position;
+    Uint8 filter[HISTORY_FILTER / 8];
+};
+
+/**
+ * A ring of index blocks. Lines are addressed by an absolute number counted
+ * from the first line ever pushed, which maps to a block and a line in it.
+ */
+struct History {
+    struct HistoryBlock **chunks;
+    size_t chunk_count;
+    size_t first;
+    size_t length;
+    size_t limit;
+
+    /* Slab arena; since lines are evicted in the order they were pushed,
+     * the slabs form a queue and only the oldest one ever runs empty.
+     * Slabs are numbered like lines, slab_number being the oldest one. */
+    struct HistorySlab {
+        char    *data;   /* NULL once compressed or spilled */
+        char    *packed; /* compressed data while in memory */
+        size_t   packed_size;
+        SDL_bool incompressible;
+        size_t   size;
+        size_t   used;
+        size_t   lines;
+        size_t   evicted;
+        off_t    offset; /* within the spill file */
+    } *slabs;
+    size_t slab_capacity;
+    size_t slab_first;
+    size_t slab_count;
+    size_t slab_number;
+    size_t resident;
+
+    /* Unlinked spill file; slabs numbered below spill_number live in it */
+    int    fd;
+    off_t  file_size;
+    size_t spill_number;
+
+    /* Slabs decompressed or mapped from the spill file */
+    struct HistoryCache {
+        size_t   slab;
+        char    *data;
+        size_t   size;
+        SDL_bool mapped;
+    } cache[HISTORY_CACHE];
+    size_t next_cache;
+
+    /* Background compression of one slab at a time. The compressor thread
+     * only ever reads the input, the slab itself is updated once the main
+     * thread reaps the result. */
+    struct HistoryJob {
+        SDL_Thread  *thread;
+        SDL_mutex   *mutex;
+        SDL_cond    *cond;
+        SDL_atomic_t done;
+        SDL_bool     quit;
+        SDL_bool     pending;
+        SDL_bool     active;
+        size_t       number;
+        const char  *input;
+        size_t       length;
+        char        *mapping;
+        size_t       mapping_size;
+        char        *orphan;
+        char        *output;
+        size_t       packed;
+    } job;
+    size_t compress_number;
+
+    /* Position of the line looked up last, consecutive lookups step on
+     * from there instead of from the start of the block */
+    SDL_bool cursor_valid;
+    size_t   cursor_number;
+    struct HistoryPosition cursor;
+
+    /* Position of the newest line and the number of cells pushed into it
+     * including trailing blanks, which continuation rows are appended to */
+    struct HistoryPosition tail;
+    int tail_cells;
+
+    /* A snapshot reads the sealed slabs on another thread. Changes to the
+     * slab queue and to how sealed slabs are stored are made under the lock,
+     * and slabs from the pinned one on are not released until it is freed. */
+    SDL_mutex *lock;
+    SDL_bool   pinned;
+    size_t     pin;
+};
+
+/**
+ * A snapshot of the scrollback buffer: the sealed slabs it covers are read
+ * from the buffer one at a time, the open one was copied when it was taken
+ */
+struct HistorySnapshot {
+    struct History *history;
+    size_t lines;    /* lines left to read */
+    size_t slab;     /* number of the slab being read */
+    size_t offset;   /* of the next line in it */
+    char  *data;     /* lines of the slab being read or NULL */
+    size_t used;
+    char  *buffer;   /* the sealed slab read last */
+    char  *packed;   /* its stored form while reading it */
+    size_t newest;   /* number of the slab that was open */
+    char  *open;     /* copy of its lines */
+    size_t open_used;
+};
+
+static Uint32 pack_attrs(const VTermScreenCellAttrs *attrs) {
+    return attrs->bold
+        | attrs->underline << 1
+        | attrs->italic    << 3
+        | attrs->blink     << 4
+        | attrs->reverse   << 5
+        | attrs->conceal   << 6
+        | attrs->strike    << 7
+        | attrs->font      << 8
+        | attrs->dwl       << 12
+        | attrs->dhl       << 13
+        | attrs->small     << 15
+        | attrs->baseline  << 16;
+}
+
+static void unpack_attrs(Uint32 packed, VTermScreenCellAttrs *attrs) {
+    attrs->bold      = packed & 1;
+    attrs->underline = packed >> 1 & 3;
+    attrs->italic    = packed >> 3 & 1;
+    attrs->blink     = packed >> 4 & 1;
+    attrs->reverse   = packed >> 5 & 1;
+    attrs->conceal   = packed >> 6 & 1;
+    attrs->strike    = packed >> 7 & 1;
+    attrs->font      = packed >> 8 & 15;
+    attrs->dwl       = packed >> 12 & 1;
+    attrs->dhl       = packed >> 13 & 3;
+    attrs->small     = packed >> 15 & 1;
+    attrs->baseline  = packed >> 16 & 3;
+}
+
+/**
+ * Copies a color with the bytes unused by its type cleared, so that runs
+ * can be compared bytewise
+ */
+static VTermColor normalize_color(const VTermColor *color) {
+    VTermColor normalized;
+    SDL_zero(normalized);
+    normalized.type = color->type;
+    if (VTERM_COLOR_IS_INDEXED(color)) {
+        normalized.indexed.idx = color->indexed.idx;
+    } else {
+        normalized.rgb.red = color->rgb.red;
+        normalized.rgb.green = color->rgb.green;
+        normalized.rgb.blue = color->rgb.blue;
+    }
+    return normalized;
+}
+
+static int count_chars(const VTermScreenCell *cell) {
+    if (cell->chars[0] == (uint32_t)-1) {
+        return 0;
+    } else if (cell->chars[0] == 0) {
+        return 1;
+    }
+    int count = 1;
+    while (count < VTERM_MAX_CHARS_PER_CELL and cell->chars[count] != 0) {
+        count++;
+    }
+    return count;
+}
+
+static void make_run(const VTermScreenCell *cell, struct HistoryRun *run) {
+    SDL_zerop(run);
+    run->attrs = pack_attrs(&cell->attrs);
+    run->fg = normalize_color(&cell->fg);
+    run->bg = normalize_color(&cell->bg);
+    run->chars = count_chars(cell);
+    run->width = cell->width;
+}
+
+static SDL_bool same_run(const struct HistoryRun *a, const struct HistoryRun *b) {
+    return a->attrs == b->attrs
+        and not SDL_memcmp(&a->fg, &b->fg, sizeof(a->fg))
+        and not SDL_memcmp(&a->bg, &b->bg, sizeof(a->bg))
+        and a->chars == b->chars
+        and a->width == b->width;
+}
+
+SDL_bool history_blank_cell(const VTermScreenCell *cell) {
+    return (cell->chars[0] == 0 or cell->chars[0] == ' ')
+        and VTERM_COLOR_IS_DEFAULT_BG(&cell->bg)
+        and not cell->attrs.reverse
+        and not cell->attrs.underline
+        and not cell->attrs.strike;
+}
+
+static size_t utf8_length(Uint32 c) {
+    return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+}
+
+static const char* utf8_decode(const char *in, Uint32 *c) {
+    const unsigned char *s = (const unsigned char*)in;
+    if (s[0] < 0x80) {
+        *c = s[0];
+        return in + 1;
+    } else if (s[0] < 0xe0) {
+        *c = (s[0] & 0x1f) << 6 | (s[1] & 0x3f);
+        return in + 2;
+    } else if (s[0] < 0xf0) {
+        *c = (s[0] & 0x0f) << 12 | (s[1] & 0x3f) << 6 | (s[2] & 0x3f);
+        return in + 3;
+    }
+    *c = (s[0] & 0x07) << 18 | (s[1] & 0x3f) << 12 | (s[2] & 0x3f) << 6 | (s[3] & 0x3f);
+    return in + 4;
+}
+
+static Uint32 cell_char(const VTermScreenCell *cell, int index) {
+    return cell->chars[index] == 0 ? ' ' : cell->chars[index];
+}
+
+static struct HistoryRun* line_runs(const struct HistoryLine *line) {
+    return (struct HistoryRun*)(line + 1);
+}
+
+static char* line_text(const struct HistoryLine *line) {
+    return (char*)(line_runs(line) + line->runs);
+}
+
+/**
+ * Trims trailing blank cells off the row and measures the encoding of the
+ * remaining ones. Returns the size of the encoded line.
+ */
+static size_t measure_line(const VTermScreenCell *cells, int *cols, size_t *runs, size_t *text) {
+    while (*cols > 0 and history_blank_cell(&cells[*cols - 1])) {
+        (*cols)--;
+    }
+    struct HistoryRun run, next;
+    *runs = 0;
+    *text = 0;
+    for (int col = 0; col < *cols; col++) {
+        make_run(&cells[col], &next);
+        if (col == 0 or not same_run(&run, &next)) {
+            run = next;
+            (*runs)++;
+        }
+        for (int i = 0; i < run.chars; i++) {
+            *text += utf8_length(cell_char(&cells[col], i));
+        }
+    }
+    return sizeof(struct HistoryLine) + *runs * sizeof(run) + *text;
+}
+
+/**
+ * Encodes a measured row of cells into the given memory
+ */
+static struct HistoryLine* encode_line(
+    const VTermScreenCell *cells, int cols, size_t runs, size_t text, void *memory
+) {
+    struct HistoryLine *line = memory;
+    line->cells = cols;
+    line->runs = runs;
+    line->text = text;
+
+    struct HistoryRun next, *current = line_runs(line) - 1;
+    char *out = line_text(line);
+    for (int col = 0; col < cols; col++) {
+        make_run(&cells[col], &next);
+        if (col == 0 or not same_run(current, &next)) {
+            *++current = next;
+        }
+        current->span++;
+        for (int i = 0; i < current->chars; i++) {
+            out += history_encode_char(cell_char(&cells[col], i), out);
+        }
+    }
+    return line;
+}
+
+size_t history_line_size(const struct HistoryLine *line) {
+    return sizeof(*line) + line->runs * sizeof(struct HistoryRun) + line->text;
+}
+
+int history_line_cells(const struct HistoryLine *line) {
+    return line->cells;
+}
+
+const char* history_line_text(const struct HistoryLine *line, size_t *length) {
+    *length = line->text;
+    return line_text(line);
+}
+
+int history_encode_char(Uint32 c, char *out) {
+    if (c < 0x80) {
+        out[0] = c;
+        return 1;
+    } else if (c < 0x800) {
+        out[0] = 0xc0 | c >> 6;
+        out[1] = 0x80 | (c & 0x3f);
+        return 2;
+    } else if (c < 0x10000) {
+        out[0] = 0xe0 | c >> 12;
+        out[1] = 0x80 | (c >> 6 & 0x3f);
+        out[2] = 0x80 | (c & 0x3f);
+        return 3;
+    }
+    out[0] = 0xf0 | c >> 18;
+    out[1] = 0x80 | (c >> 12 & 0x3f);
+    out[2] = 0x80 | (c >> 6 & 0x3f);
+    out[3] = 0x80 | (c & 0x3f);
+    return 4;
+}
+
+/**
+ * Hashes a pair of adjacent text bytes to a bit of a block filter
+ */
+static size_t pair_bit(Uint8 first, Uint8 second) {
+    return (((Uint32)(first << 8 | second) * 2654435761u) >> 16) % HISTORY_FILTER;
+}
+
+static void filter_text(Uint8 *filter, const char *text, size_t length) {
+    for (size_t i = 1; i < length; i++) {
+        size_t bit = pair_bit(text[i - 1], text[i]);
+        filter[bit / 8] |= 1 << bit % 8;
+    }
+}
+
+/**
+ * Returns SDL_FALSE if the block filter proves that none of its lines
+ * contains the text. Texts shorter than a pair always pass.
+ */
+static SDL_bool filter_match(const Uint8 *filter, const char *text, size_t length) {
+    for (size_t i = 1; i < length; i++) {
+        size_t bit = pair_bit(text[i - 1], text[i]);
+        if (not (filter[bit / 8] & 1 << bit % 8)) {
+            return SDL_FALSE;
+        }
+    }
+    return SDL_TRUE;
+}
+
+const char* history_find_text(const char *text, size_t length, const char *needle, size_t size) {
+    if (size == 0) {
+        return text;
+    } else if (size > length) {
+        return NULL;
+    } else if (size == 1) {
+        return memchr(text, needle[0], length);
+    }
+    size_t i = 0;
+#ifdef __SSE2__
+    /* Compare 16 candidate positions at once against the first and the last
+     * byte of the needle and only verify the positions matching both */
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[size - 1]);
+    for (; i + size - 1 + 16 <= length; i += 16) {
+        __m128i head = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i tail = _mm_loadu_si128((const __m128i*)(text + i + size - 1));
+        unsigned mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))
+        );
+        for (; mask != 0; mask &= mask - 1) {
+            size_t candidate = i + __builtin_ctz(mask);
+            if (not SDL_memcmp(text + candidate + 1, needle + 1, size - 2)) {
+                return text + candidate;
+            }
+        }
+    }
+#endif
+    return memmem(text + i, length - i, needle, size);
+}
+
+int history_decode_line(
+    const struct HistoryLine *line, VTermScreenCell *cells, int cols,
+    const VTermScreenCell *blank
+) {
+    const struct HistoryRun *run = line_runs(line);
+    const char *text = line_text(line);
+    int col = 0;
+    for (int r = 0; r < line->runs and col < cols; r++, run++) {
+        for (int n = 0; n < run->span and col < cols; n++, col++) {
+            VTermScreenCell *cell = &cells[col];
+            SDL_zerop(cell);
+            unpack_attrs(run->attrs, &cell->attrs);
+            cell->fg = run->fg;
+            cell->bg = run->bg;
+            cell->width = run->width;
+            if (run->chars == 0) {
+                cell->chars[0] = (uint32_t)-1;
+            }
+            for (int i = 0; i < run->chars; i++) {
+                text = utf8_decode(text, &cell->chars[i]);
+            }
+        }
+    }
+    int decoded = col;
+    for (; col < cols; col++) {
+        cells[col] = *blank;
+    }
+    return decoded;
+}
+
+/**
+ * Wraps the line at the given width and returns the first cell of the given
+ * wrapped row, or the number of cells if the line has fewer rows. Wide
+ * characters not fitting at the end of a row are moved to the next one.
+ * Stores the number of rows of the line if rows is not NULL.
+ */
+static int wrap_line(const struct HistoryLine *line, int cols, int row, int *rows) {
+    if (row == 0) {
+        return 0;
+    }
+    const struct HistoryRun *run = line_runs(line);
+    int cell = 0, current = 0, x = 0;
+    for (int r = 0; r < line->runs; r++, run++) {
+        for (int n = 0; n < run->span; n++, cell++, x++) {
+            if (run->chars == 0) {
+                continue;
+            } else if (x >= cols or (run->width > 1 and x > 0 and x + run->width > cols)) {
+                if (++current == row) {
+                    return cell;
+                }
+                x = 0;
+            }
+        }
+    }
+    if (rows != NULL) {
+        *rows = current + 1;
+    }
+    return line->cells;
+}
+
+int history_line_rows(const struct HistoryLine *line, int cols) {
+    int rows;
+    wrap_line(line, SDL_max(cols, 1), -1, &rows);
+    return rows;
+}
+
+int history_line_wrap(const struct HistoryLine *line, int cols, int row) {
+    return wrap_line(line, SDL_max(cols, 1), row, NULL);
+}
+
+/**
+ * Returns the index entry of the block with the given number, allocating
+ * its chunk if necessary
+ */
+static struct HistoryBlock* history_block(struct History *history, size_t block) {
+    size_t chunk = block / HISTORY_CHUNK;
+    if (history->limit > 0) {
+        chunk %= history->chunk_count;
+    }
+    if (history->chunks[chunk] == NULL) {
+        history->chunks[chunk] = SDL_malloc(sizeof(**history->chunks) * HISTORY_CHUNK);
+    }
+    return &history->chunks[chunk][block % HISTORY_CHUNK];
+}
+
+/**
+ * Returns the slab at the given position of the slab queue
+ */
+static struct HistorySlab* history_slab(const struct History *history, size_t index) {
+    return &history->slabs[(history->slab_first + index) % history->slab_capacity];
+}
+
+static size_t align_size(size_t size) {
+    return (size + HISTORY_ALIGN - 1) & ~(size_t)(HISTORY_ALIGN - 1);
+}
+
+static size_t page_size(size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+/**
+ * Creates the spill file in TMPDIR and unlinks it right away, so that it
+ * disappears with the process
+ */
+static SDL_bool history_open_file(struct History *history) {
+    const char *directory = SDL_getenv("TMPDIR");
+    char path[4096];
+    SDL_snprintf(path, sizeof(path), "%s/sdlterm-history-XXXXXX", directory ? directory : "/tmp");
+    history->fd = mkostemp(path, O_CLOEXEC);
+    if (history->fd < 0) {
+        SDL_Log("Failed to create history spill file %s", path);
+        return SDL_FALSE;
+    }
+    unlink(path);
+    return SDL_TRUE;
+}
+
+/**
+ * Returns the number of bytes a slab occupies in the spill file
+ */
+static size_t stored_size(const struct HistorySlab *slab) {
+    return slab->packed_size ? slab->packed_size : slab->used;
+}
+
+/**
+ * Appends the slab to the spill file, compressed if it is, and frees its
+ * memory. Returns SDL_FALSE if it has to stay in memory.
+ */
+static SDL_bool history_write(struct History *history, struct HistorySlab *slab) {
+    if (history->fd == -1 and not history_open_file(history)) {
+        history->fd = -2;
+    }
+    if (history->fd < 0) {
+        return SDL_FALSE;
+    }
+    const char *data = slab->packed ? slab->packed : slab->data;
+    size_t size = stored_size(slab);
+    for (size_t written = 0; written < size;) {
+        ssize_t result = pwrite(
+            history->fd, data + written, size - written, history->file_size + written
+        );
+        if (result <= 0) {
+            SDL_Log("Failed to spill history to disk");
+            return SDL_FALSE;
+        }
+        written += result;
+    }
+    SDL_free(slab->data);
+    SDL_free(slab->packed);
+    slab->data = slab->packed = NULL;
+    slab->offset = history->file_size;
+    history->file_size += page_size(size);
+    return SDL_TRUE;
+}
+
+/**
+ * Maps the stored contents of a spilled slab
+ */
+static char* history_map(struct History *history, const struct HistorySlab *slab) {
+    char *data = mmap(
+        NULL, page_size(stored_size(slab)), PROT_READ, MAP_SHARED, history->fd, slab->offset
+    );
+    return data == MAP_FAILED ? NULL : data;
+}
+
+/**
+ * Punches the range of a spilled slab out of the spill file
+ */
+static void history_punch(struct History *history, const struct HistorySlab *slab) {
+    fallocate(
+        history->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+        slab->offset, page_size(stored_size(slab))
+    );
+}
+
+/**
+ * Spills the oldest slabs held in memory until the memory budget is met.
+ * The newest slab is still being filled and never spilled, neither is a
+ * slab the compressor is reading from.
+ */
+static void history_spill(struct History *history) {
+    history->spill_number = SDL_max(history->spill_number, history->slab_number);
+    size_t newest = history->slab_number + history->slab_count - 1;
+    while (history->resident > HISTORY_RESIDENT and history->spill_number < newest) {
+        struct HistorySlab *slab = history_slab(history, history->spill_number - history->slab_number);
+        if (history->job.active and history->job.number == history->spill_number and slab->data) {
+            break;
+        }
+        size_t size = slab->packed ? slab->packed_size : slab->size;
+        if (not history_write(history, slab)) {
+            break;
+        }
+        history->resident -= size;
+        history->spill_number++;
+    }
+}
+
+/**
+ * Drops the cached data of the slab with the given number
+ */
+static void history_forget(struct History *history, size_t number) {
+    for (int i = 0; i < HISTORY_CACHE; i++) {
+        struct HistoryCache *cache = &history->cache[i];
+        if (cache->data == NULL or cache->slab != number) {
+            continue;
+        } else if (cache->mapped) {
+            munmap(cache->data, cache->size);
+        } else {
+            SDL_free(cache->data);
+        }
+        cache->data = NULL;
+    }
+}
+
+/**
+ * Returns the lines of the slab with the given number, decompressing it or
+ * mapping it back into memory if necessary. Such data stays valid until
+ * HISTORY_CACHE other slabs were accessed.
+ */
+static char* history_slab_data(struct History *history, size_t number) {
+    struct HistorySlab *slab = history_slab(history, number - history->slab_number);
+    if (slab->data != NULL) {
+        return slab->data;
+    }
+    for (int i = 0; i < HISTORY_CACHE; i++) {
+        if (history->cache[i].data != NULL and history->cache[i].slab == number) {
+            return history->cache[i].data;
+        }
+    }
+    struct HistoryCache *cache = &history->cache[history->next_cache++ % HISTORY_CACHE];
+    history_forget(history, cache->slab);
+    cache->slab = number;
+    cache->mapped = SDL_FALSE;
+    const char *packed = slab->packed;
+    char *mapping = NULL;
+    if (slab->packed == NULL) {
+        mapping = history_map(history, slab);
+        if (mapping == NULL or slab->packed_size == 0) {
+            /* Uncompressed slabs are used straight from the mapping */
+            cache->data = mapping;
+            cache->size = page_size(slab->used);
+            cache->mapped = SDL_TRUE;
+            return cache->data;
+        }
+        packed = mapping;
+    }
+    cache->data = SDL_malloc(slab->used);
+    cache->size = slab->used;
+    if (lz_decompress(packed, slab->packed_size, cache->data, slab->used) != slab->used) {
+        SDL_Log("Failed to decompress history");
+        SDL_free(cache->data);
+        cache->data = NULL;
+    }
+    if (mapping != NULL) {
+        munmap(mapping, page_size(slab->packed_size));
+    }
+    return cache->data;
+}
+
+/**
+ * Compressor thread: compresses the posted slab unless it shrinks by less
+ * than an eighth, in which case it is left alone
+ */
+static int history_compress(void *data) {
+    struct HistoryJob *job = data;
+    SDL_LockMutex(job->mutex);
+    for (;;) {
+        while (not job->quit and not job->pending) {
+            SDL_CondWait(job->cond, job->mutex);
+        }
+        if (job->quit) {
+            break;
+        }
+        const char *input = job->input;
+        size_t length = job->length;
+        job->pending = SDL_FALSE;
+        SDL_UnlockMutex(job->mutex);
+        char *output = SDL_malloc(length);
+        size_t packed = lz_compress(input, length, output, length - length / 8);
+        SDL_LockMutex(job->mutex);
+        job->output = output;
+        job->packed = packed;
+        SDL_AtomicSet(&job->done, 1);
+    }
+    SDL_UnlockMutex(job->mutex);
+    return 0;
+}
+
+/**
+ * Posts the oldest sealed slab that is neither compressed nor known to be
+ * incompressible to the compressor thread
+ */
+static void history_schedule(struct History *history) {
+    struct HistoryJob *job = &history->job;
+    if (job->active or job->thread == NULL) {
+        return;
+    }
+    history->compress_number = SDL_max(history->compress_number, history->slab_number);
+    size_t newest = history->slab_number + history->slab_count - 1;
+    for (; history->compress_number < newest; history->compress_number++) {
+        struct HistorySlab *slab = history_slab(history, history->compress_number - history->slab_number);
+        if (slab->packed_size > 0 or slab->incompressible) {
+            continue;
+        }
+        job->input = slab->data;
+        if (slab->data == NULL) {
+            job->mapping = history_map(history, slab);
+            job->mapping_size = page_size(slab->used);
+            job->input = job->mapping;
+        }
+        if (job->input == NULL) {
+            continue;
+        }
+        job->active = SDL_TRUE;
+        job->number = history->compress_number;
+        job->length = slab->used;
+        SDL_LockMutex(job->mutex);
+        job->pending = SDL_TRUE;
+        SDL_CondSignal(job->cond);
+        SDL_UnlockMutex(job->mutex);
+        return;
+    }
+}
+
+/**
+ * Applies the result of the compressor thread, if there is one, and posts
+ * the next slab
+ */
+static void history_reap(struct History *history) {
+    struct HistoryJob *job = &history->job;
+    if (not job->active or not SDL_AtomicGet(&job->done)) {
+        return;
+    }
+    SDL_LockMutex(job->mutex);
+    char *output = job->output;
+    size_t packed = job->packed;
+    SDL_AtomicSet(&job->done, 0);
+    job->output = NULL;
+    SDL_UnlockMutex(job->mutex);
+    SDL_LockMutex(history->lock);
+    job->active = SDL_FALSE;
+    if (job->mapping != NULL) {
+        munmap(job->mapping, job->mapping_size);
+        job->mapping = NULL;
+    }
+    SDL_free(job->orphan);
+    job->orphan = NULL;
+
+    if (job->number < history->slab_number or packed == 0) {
+        if (job->number >= history->slab_number) {
+            history_slab(history, job->number - history->slab_number)->incompressible = SDL_TRUE;
+        }
+        SDL_free(output);
+    } else {
+        struct HistorySlab *slab = history_slab(history, job->number - history->slab_number);
+        if (slab->data == NULL) {
+            /* The slab was spilled uncompressed, its whole range is punched
+             * out before it is replaced by the compressed data */
+            history_forget(history, job->number);
+            history_punch(history, slab);
+        }
+        slab->packed = SDL_realloc(output, packed);
+        slab->packed_size = packed;
+        if (slab->data != NULL) {
+            SDL_free(slab->data);
+            slab->data = NULL;
+            history->resident += packed;
+            history->resident -= slab->size;
+        } else if (not history_write(history, slab)) {
+            history->resident += packed;
+        }
+    }
+    history->compress_number = job->number + 1;
+    history_spill(history);
+    history_schedule(history);
+    SDL_UnlockMutex(history->lock);
+}
+
+/**
+ * Releases the oldest slab, punching its hole into the spill file
+ */
+static void history_release(struct History *history) {
+    struct HistorySlab *slab = history_slab(history, 0);
+    struct HistoryJob *job = &history->job;
+    if (job->active and job->number == history->slab_number and slab->data != NULL) {
+        /* The compressor still reads the data, free it once it is done */
+        job->orphan = slab->data;
+        slab->data = NULL;
+        history->resident -= slab->size;
+    }
+    if (slab->data != NULL) {
+        history->resident -= slab->size;
+    } else if (slab->packed != NULL) {
+        history->resident -= slab->packed_size;
+    } else if (history->slab_number < history->spill_number) {
+        history_punch(history, slab);
+    }
+    SDL_free(slab->data);
+    SDL_free(slab->packed);
+    history_forget(history, history->slab_number);
+    history->slab_first = (history->slab_first + 1) % history->slab_capacity;
+    history->slab_count--;
+    history->slab_number++;
+}
+
+/**
+ * Releases the oldest slabs whose lines were all evicted; the newest slab is
+ * kept for further allocations. Lookups step through a block from its first
+ * line on, so the slab holding the first line of the oldest block is kept
+ * as well, even if that line was evicted.
+ */
+static void history_collect(struct History *history) {
+    while (history->slab_count > 1) {
+        struct HistorySlab *slab = history_slab(history, 0);
+        SDL_bool referenced = history->length > 0
+            and history_block(history, history->first / HISTORY_BLOCK)->position.slab == history->slab_number;
+        if (
+            slab->evicted < slab->lines or referenced or
+            (history->pinned and history->slab_number >= history->pin)
+        ) {
+            break;
+        }
+        history_release(history);
+    }
+}
+
+/**
+ * Bump-allocates memory for a line from the newest slab, starting a new
+ * slab if it is full. The full slab is handed to the compressor then.
+ */
+static struct HistoryPosition history_allocate(struct History *history, size_t size) {
+    size = align_size(size);
+    struct HistorySlab *slab = NULL;
+    if (history->slab_count > 0) {
+        slab = history_slab(history, history->slab_count - 1);
+    }
+    if (slab == NULL or slab->size - slab->used < size) {
+        SDL_LockMutex(history->lock);
+        if (history->slab_count == history->slab_capacity) {
+            size_t capacity = history->slab_capacity ? history->slab_capacity * 2 : 8;
+            struct HistorySlab *slabs = SDL_malloc(sizeof(*slabs) * capacity);
+            for (size_t i = 0; i < history->slab_count; i++) {
+                slabs[i] = *history_slab(history, i);
+            }
+            SDL_free(history->slabs);
+            history->slabs = slabs;
+            history->slab_capacity = capacity;
+            history->slab_first = 0;
+        }
+        slab = history_slab(history, history->slab_count++);
+        SDL_zerop(slab);
+        slab->size = SDL_max(HISTORY_SLAB, size);
+        slab->data = SDL_malloc(slab->size);
+        history->resident += slab->size;
+        history_collect(history);
+        history_spill(history);
+        history_schedule(history);
+        SDL_UnlockMutex(history->lock);
+    }
+    struct HistoryPosition position = {
+        .slab = history->slab_number + history->slab_count - 1,
+        .offset = slab->used
+    };
+    slab->used += size;
+    slab->lines++;
+    return position;
+}
+
+/**
+ * Evicts the oldest line, releasing its slab once all of its lines are gone.
+ * Slabs pinned by a snapshot are kept after their lines were evicted, the
+ * oldest line lives in the first slab with lines left.
+ */
+static void history_evict(struct History *history) {
+    SDL_LockMutex(history->lock);
+    history_collect(history);
+    size_t index = 0;
+    while (history_slab(history, index)->evicted == history_slab(history, index)->lines) {
+        index++;
+    }
+    history_slab(history, index)->evicted++;
+    history->first++;
+    history->length--;
+    history_collect(history);
+    SDL_UnlockMutex(history->lock);
+}
+
+struct History* history_create(size_t limit) {
+    struct History *history = SDL_calloc(1, sizeof(*history));
+    history->limit = limit;
+    history->fd = -1;
+    history->lock = SDL_CreateMutex();
+    /* A limited ring needs one more chunk than the limit fills, as both the
+     * oldest and the newest line may sit in a partially used chunk */
+    size_t lines = HISTORY_CHUNK * HISTORY_BLOCK;
+    history->chunk_count = limit > 0 ? (limit + lines - 1) / lines + 1 : 16;
+    history->chunks = SDL_calloc(history->chunk_count, sizeof(*history->chunks));
+    history->job.mutex = SDL_CreateMutex();
+    history->job.cond = SDL_CreateCond();
+    history->job.thread = SDL_CreateThread(history_compress, "history", &history->job);
+    if (history->job.thread == NULL) {
+        SDL_Log("Failed to start history compression: %s", SDL_GetError());
+    }
+    return history;
+}
+
+void history_destroy(struct History *history) {
+    struct HistoryJob *job = &history->job;
+    if (job->thread != NULL) {
+        SDL_LockMutex(job->mutex);
+        job->quit = SDL_TRUE;
+        SDL_CondSignal(job->cond);
+        SDL_UnlockMutex(job->mutex);
+        SDL_WaitThread(job->thread, NULL);
+    }
+    SDL_free(job->output);
+    SDL_free(job->orphan);
+    if (job->mapping != NULL) {
+        munmap(job->mapping, job->mapping_size);
+    }
+    SDL_DestroyCond(job->cond);
+    SDL_DestroyMutex(job->mutex);
+    SDL_DestroyMutex(history->lock);
+    for (int i = 0; i < HISTORY_CACHE; i++) {
+        history_forget(history, history->cache[i].slab);
+    }
+    if (history->fd >= 0) {
+        close(history->fd);
+    }
+    for (size_t i = 0; i < history->slab_count; i++) {
+        SDL_free(history_slab(history, i)->data);
+        SDL_free(history_slab(history, i)->packed);
+    }
+    SDL_free(history->slabs);
+    for (size_t i = 0; i < history->chunk_count; i++) {
+        SDL_free(history->chunks[i]);
+    }
+    SDL_free(history->chunks);
+    SDL_free(history);
+}
+
+/**
+ * Appends a row of cells to the newest line, padded to the cells pushed into
+ * it before. Only the newest slab is still writable, so this fails once the
+ * line lives in a sealed one, or if the longer line no longer fits.
+ */
+static SDL_bool history_extend(
+    struct History *history, const VTermScreenCell *cells, int cols, const VTermScreenCell *blank
+) {
+    size_t newest = history->slab_number + history->slab_count - 1;
+    int width = history->tail_cells + cols;
+    if (history->length == 0 or history->tail.slab != newest or width > HISTORY_LINE_CELLS) {
+        return SDL_FALSE;
+    }
+    struct HistorySlab *slab = history_slab(history, history->slab_count - 1);
+    struct HistoryLine *line = (struct HistoryLine*)(slab->data + history->tail.offset);
+    VTermScreenCell *joined = SDL_malloc(sizeof(*joined) * width);
+    history_decode_line(line, joined, history->tail_cells, blank);
+    SDL_memcpy(joined + history->tail_cells, cells, sizeof(*cells) * cols);
+    size_t runs, text;
+    int count = width;
+    size_t size = align_size(measure_line(joined, &count, &runs, &text));
+    SDL_bool fits = history->tail.offset + size <= slab->size;
+    if (fits) {
+        encode_line(joined, count, runs, text, line);
+        slab->used = history->tail.offset + size;
+        size_t number = history->first + history->length - 1;
+        filter_text(history_block(history, number / HISTORY_BLOCK)->filter, line_text(line), line->text);
+        history->tail_cells = width;
+    }
+    SDL_free(joined);
+    return fits;
+}
+
+SDL_bool history_push(
+    struct History *history, const VTermScreenCell *cells, int cols,
+    const VTermScreenCell *blank, SDL_bool continuation
+) {
+    history_reap(history);
+    if (continuation and history_extend(history, cells, cols, blank)) {
+        return SDL_TRUE;
+    }
+    if (history->limit > 0 and history->length == history->limit) {
+        history_evict(history);
+    }
+    size_t number = history->first + history->length;
+    size_t block = number / HISTORY_BLOCK;
+    if (history->limit == 0 and block / HISTORY_CHUNK >= history->chunk_count) {
+        size_t count = history->chunk_count * 2;
+        history->chunks = SDL_realloc(history->chunks, sizeof(*history->chunks) * count);
+        SDL_memset(
+            history->chunks + history->chunk_count, 0,
+            sizeof(*history->chunks) * (count - history->chunk_count)
+        );
+        history->chunk_count = count;
+    }
+    history->tail_cells = cols;
+    size_t runs, text;
+    size_t size = measure_line(cells, &cols, &runs, &text);
+    struct HistoryPosition position = history_allocate(history, size);
+    struct HistorySlab *slab = history_slab(history, position.slab - history->slab_number);
+    struct HistoryLine *line = encode_line(cells, cols, runs, text, slab->data + position.offset);
+    struct HistoryBlock *entry = history_block(history, block);
+    if (number % HISTORY_BLOCK == 0) {
+        entry->position = position;
+        SDL_memset(entry->filter, 0, sizeof(entry->filter));
+    }
+    filter_text(entry->filter, line_text(line), line->text);
+    history->tail = position;
+    history->length++;
+    return SDL_FALSE;
+}
+
+SDL_bool history_pop(
+    struct History *history, VTermScreenCell *cells, int cols,
+    const VTermScreenCell *blank, SDL_bool *continuation
+) {
+    history_reap(history);
+    size_t newest = history->slab_number + history->slab_count - 1;
+    if (history->length == 0 or history->tail.slab != newest) {
+        return SDL_FALSE;
+    }
+    struct HistorySlab *slab = history_slab(history, history->slab_count - 1);
+    struct HistoryLine *line = (struct HistoryLine*)(slab->data + history->tail.offset);
+    int rows = history_line_rows(line, cols);
+    int start = history_line_wrap(line, cols, rows - 1);
+    int stored = line->cells;
+    VTermScreenCell *decoded = SDL_malloc(sizeof(*decoded) * SDL_max(stored, 1));
+    history_decode_line(line, decoded, stored, blank);
+    int count = SDL_min(stored - start, cols);
+    SDL_memcpy(cells, decoded + start, sizeof(*cells) * count);
+    for (int col = count; col < cols; col++) {
+        cells[col] = *blank;
+    }
+    *continuation = rows > 1;
+    history->cursor_valid = SDL_FALSE;
+    if (rows > 1) {
+        /* Keep the rows before the popped one */
+        size_t runs, text;
+        history->tail_cells = start;
+        size_t size = measure_line(decoded, &start, &runs, &text);
+        encode_line(decoded, start, runs, text, line);
+        slab->used = history->tail.offset + align_size(size);
+    } else {
+        slab->used = history->tail.offset;
+        slab->lines--;
+        history->length--;
+        /* The line before is found again by looking it up */
+        history->tail.slab = (size_t)-1;
+        if (history->length > 0) {
+            history->tail_cells = history_get(history, history->length - 1)->cells;
+            if (history->cursor_valid) {
+                history->tail = history->cursor;
+            }
+        }
+    }
+    SDL_free(decoded);
+    return SDL_TRUE;
+}
+
+size_t history_length(const struct History *history) {
+    return history->length;
+}
+
+const struct HistoryLine* history_get(struct History *history, size_t index) {
+    static const struct HistoryLine empty;
+    history_reap(history);
+    size_t number = history->first + index;
+    size_t current = number - number % HISTORY_BLOCK;
+    struct HistoryPosition position = history_block(history, number / HISTORY_BLOCK)->position;
+    if (
+        history->cursor_valid and history->cursor_number >= history->first and
+        history->cursor_number <= number and history->cursor_number > current
+    ) {
+        current = history->cursor_number;
+        position = history->cursor;
+    }
+    SDL_assert(position.slab >= history->slab_number);
+    for (;;) {
+        struct HistorySlab *slab = history_slab(history, position.slab - history->slab_number);
+        if (position.offset == slab->used) {
+            position.slab++;
+            position.offset = 0;
+            continue;
+        }
+        char *data = history_slab_data(history, position.slab);
+        if (data == NULL) {
+            return &empty;
+        }
+        const struct HistoryLine *line = (const struct HistoryLine*)(data + position.offset);
+        if (current == number) {
+            history->cursor_valid = SDL_TRUE;
+            history->cursor_number = number;
+            history->cursor = position;
+            return line;
+        }
+        position.offset += align_size(history_line_size(line));
+        current++;
+    }
+}
+
+size_t history_search(
+    struct History *history, const char *text, size_t length, size_t index, SDL_bool backward
+) {
+    if (index >= history->length) {
+        return (size_t)-1;
+    }
+    /* Blocks are scanned from their first line on, as lookups only step
+     * forward; a backward search keeps the last match in the block */
+    size_t number = history->first + index;
+    for (;;) {
+        size_t block = number / HISTORY_BLOCK;
+        size_t start = SDL_max(block * HISTORY_BLOCK, history->first);
+        size_t end = SDL_min((block + 1) * HISTORY_BLOCK, history->first + history->length);
+        if (filter_match(history_block(history, block)->filter, text, length)) {
+            size_t found = (size_t)-1;
+            for (size_t n = backward ? start : number; n < (backward ? number + 1 : end); n++) {
+                size_t size;
+                const char *line = history_line_text(history_get(history, n - history->first), &size);
+                if (history_find_text(line, size, text, length) != NULL) {
+                    found = n - history->first;
+                    if (not backward) {
+                        break;
+                    }
+                }
+            }
+            if (found != (size_t)-1) {
+                return found;
+            }
+        }
+        if (backward) {
+            if (start == history->first) {
+                return (size_t)-1;
+            }
+            number = start - 1;
+        } else {
+            if (end == history->first + history->length) {
+                return (size_t)-1;
+            }
+            number = end;
+        }
+    }
+}
+
+struct HistorySnapshot* history_snapshot(struct History *history) {
+    history_reap(history);
+    if (history->pinned) {
+        return NULL;
+    }
+    struct HistorySnapshot *snapshot = SDL_calloc(1, sizeof(*snapshot));
+    snapshot->history = history;
+    history_get(history, 0);
+    if (history->length == 0 or not history->cursor_valid or history->cursor_number != history->first) {
+        return snapshot;
+    }
+    snapshot->lines = history->length;
+    snapshot->slab = history->cursor.slab;
+    snapshot->offset = history->cursor.offset;
+    snapshot->newest = history->slab_number + history->slab_count - 1;
+    struct HistorySlab *open = history_slab(history, history->slab_count - 1);
+    snapshot->open_used = open->used;
+    snapshot->open = SDL_malloc(SDL_max(open->used, 1));
+    SDL_memcpy(snapshot->open, open->data, open->used);
+    history->pinned = SDL_TRUE;
+    history->pin = snapshot->slab;
+    return snapshot;
+}
+
+/**
+ * Reads the lines of the snapshot slab being read into its buffer. Sealed
+ * slabs never change, only the way they are stored, so their stored form is
+ * copied under the lock and decompressed outside of it.
+ */
+static SDL_bool history_snapshot_load(struct HistorySnapshot *snapshot) {
+    struct History *history = snapshot->history;
+    if (snapshot->slab == snapshot->newest) {
+        snapshot->data = snapshot->open;
+        snapshot->used = snapshot->open_used;
+        return SDL_TRUE;
+    } else if (snapshot->slab > snapshot->newest) {
+        return SDL_FALSE;
+    }
+    SDL_LockMutex(history->lock);
+    struct HistorySlab *slab = history_slab(history, snapshot->slab - history->slab_number);
+    size_t used = slab->used;
+    size_t size = stored_size(slab);
+    size_t packed = slab->data == NULL ? slab->packed_size : 0;
+    snapshot->buffer = SDL_realloc(snapshot->buffer, SDL_max(used, 1));
+    snapshot->packed = SDL_realloc(snapshot->packed, SDL_max(packed, 1));
+    char *target = packed > 0 ? snapshot->packed : snapshot->buffer;
+    SDL_bool loaded = SDL_TRUE;
+    if (slab->data != NULL) {
+        SDL_memcpy(target, slab->data, used);
+    } else if (slab->packed != NULL) {
+        SDL_memcpy(target, slab->packed, size);
+    } else {
+        for (size_t read = 0; loaded and read < size;) {
+            ssize_t result = pread(history->fd, target + read, size - read, slab->offset + read);
+            loaded = result > 0;
+            read += loaded ? result : 0;
+        }
+    }
+    SDL_UnlockMutex(history->lock);
+    if (loaded and packed > 0) {
+        loaded = lz_decompress(snapshot->packed, packed, snapshot->buffer, used) == used;
+    }
+    if (not loaded) {
+        SDL_Log("Failed to read history snapshot");
+        return SDL_FALSE;
+    }
+    snapshot->data = snapshot->buffer;
+    snapshot->used = used;
+    return SDL_TRUE;
+}
+
+const struct HistoryLine* history_snapshot_next(struct HistorySnapshot *snapshot) {
+    if (snapshot->lines == 0) {
+        return NULL;
+    }
+    while (snapshot->data == NULL or snapshot->offset >= snapshot->used) {
+        if (snapshot->data != NULL) {
+            snapshot->slab++;
+            snapshot->offset = 0;
+        }
+        if (not history_snapshot_load(snapshot)) {
+            snapshot->lines = 0;
+            return NULL;
+        }
+    }
+    const struct HistoryLine *line = (const struct HistoryLine*)(snapshot->data + snapshot->offset);
+    snapshot->offset += align_size(history_line_size(line));
+    snapshot->lines--;
+    return line;
+}
+
+void history_snapshot_free(struct HistorySnapshot *snapshot) {
+    if (snapshot->open != NULL) {
+        snapshot->history->pinned = SDL_FALSE;
+    }
+    SDL_free(snapshot->open);
+    SDL_free(snapshot->buffer);
+    SDL_free(snapshot->packed);
+    SDL_free(snapshot);
+}
+
+void history_statistics(struct History *history, struct HistoryStatistics *statistics) {
+    history_reap(history);
+    SDL_zerop(statistics);
+    statistics->lines = history->length;
+    statistics->slabs = history->slab_count;
+    statistics->allocated = history->resident;
+    for (size_t i = 0; i < history->slab_count; i++) {
+        const struct HistorySlab *slab = history_slab(history, i);
+        size_t number = history->slab_number + i;
+        statistics->encoded += slab->used;
+        if (number < history->spill_number) {
+            statistics->spilled++;
+            statistics->stored += page_size(stored_size(slab));
+        }
+        if (slab->packed_size > 0) {
+            statistics->compressed++;
+            statistics->unpacked += slab->used;
+            statistics->packed += slab->packed_size;
+        }
+    }
+    statistics->index = history->chunk_count * sizeof(*history->chunks)
+        + history->slab_capacity * sizeof(*history->slabs);
+    for (size_t i = 0; i < history->chunk_count; i++) {
+        if (history->chunks[i] != NULL) {
+            statistics->index += HISTORY_CHUNK * sizeof(**history->chunks);
+        }
+    }
+}
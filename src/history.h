@@ -0,0 +1,185 @@
+#ifndef SDLTERM_HISTORY_H
+#define SDLTERM_HISTORY_H
+
+#include <SDL2/SDL.h>
+#include <vterm.h>
+
+/**
+ * A scrollback line in its compact encoding: the UTF-8 text of its cells and
+ * a run-length list of the pens (attributes and colors) applied to them.
+ * Trailing blank cells are not stored.
+ */
+struct HistoryLine;
+
+/**
+ * Returns the size of the encoded line in bytes.
+ */
+extern size_t history_line_size(const struct HistoryLine *line);
+
+/**
+ * Returns the number of cells stored in the line, i.e. without the trimmed
+ * trailing blank cells.
+ */
+extern int history_line_cells(const struct HistoryLine *line);
+
+/**
+ * Returns the UTF-8 text of the line and stores its length in bytes. Blank
+ * cells are represented by spaces, the second halves of wide characters are
+ * not represented at all.
+ */
+extern const char* history_line_text(const struct HistoryLine *line, size_t *length);
+
+/**
+ * Encodes a character as UTF-8 the way line texts are stored, returning the
+ * number of bytes written, at most 4.
+ */
+extern int history_encode_char(Uint32 c, char *out);
+
+/**
+ * Returns SDL_TRUE if the cell shows nothing: a space or an empty cell
+ * without background, reverse video, underline or strikethrough. Such cells
+ * are trimmed off the end of stored lines.
+ */
+extern SDL_bool history_blank_cell(const VTermScreenCell *cell);
+
+/**
+ * Decodes the line into the given row of cells. Cells beyond the stored ones
+ * are set to the blank cell. Returns the number of decoded cells, which is
+ * less than the number of stored cells if the row is narrower.
+ */
+extern int history_decode_line(
+    const struct HistoryLine *line, VTermScreenCell *cells, int cols,
+    const VTermScreenCell *blank
+);
+
+/**
+ * Returns the number of rows the line takes when wrapped at the given width.
+ * Wide characters are never split across rows.
+ */
+extern int history_line_rows(const struct HistoryLine *line, int cols);
+
+/**
+ * Returns the first cell of a row of the line wrapped at the given width, or
+ * the number of stored cells if the line has fewer rows.
+ */
+extern int history_line_wrap(const struct HistoryLine *line, int cols, int row);
+
+/**
+ * Returns the first occurrence of the needle in the text or NULL.
+ */
+extern const char* history_find_text(const char *text, size_t length, const char *needle, size_t size);
+
+/**
+ * The scrollback buffer: a ring of encoded lines, evicting the oldest line
+ * once the limit is reached. Lines are allocated from large slabs, which are
+ * released as a whole once all of their lines were evicted. Full slabs are
+ * compressed by a background thread. Only the newest slabs are kept in
+ * memory, older ones are spilled to an unlinked temporary file and mapped
+ * back on access. Lines are indexed for text search as they are pushed.
+ * Lines are stored unwrapped and wrapped to the view width when rendered.
+ */
+struct History;
+
+/**
+ * Memory usage of the scrollback buffer
+ */
+struct HistoryStatistics {
+    size_t lines;
+    size_t slabs;
+    size_t spilled;    /* slabs in the spill file */
+    size_t stored;     /* bytes they take in the spill file */
+    size_t compressed; /* slabs compressed */
+    size_t encoded;    /* bytes of encoded lines */
+    size_t allocated;  /* bytes of slabs in memory */
+    size_t unpacked;   /* bytes of compressed slabs before compression */
+    size_t packed;     /* bytes of compressed slabs after compression */
+    size_t index;      /* bytes of line index and slab bookkeeping */
+};
+
+/**
+ * Creates an empty scrollback buffer holding at most limit lines. A limit of
+ * 0 lets the buffer grow without bounds.
+ */
+extern struct History* history_create(size_t limit);
+
+/**
+ * Frees the scrollback buffer and all of its lines.
+ */
+extern void history_destroy(struct History *history);
+
+/**
+ * Encodes a row of cells and appends it as the newest line. A row continuing
+ * the previous one is appended to the newest line instead where possible,
+ * after padding it with blank cells to the width it was pushed with. Returns
+ * SDL_TRUE if the row was appended to the newest line.
+ */
+extern SDL_bool history_push(
+    struct History *history, const VTermScreenCell *cells, int cols,
+    const VTermScreenCell *blank, SDL_bool continuation
+);
+
+/**
+ * Removes the last row of the newest line wrapped at the given width and
+ * decodes it into cells, padding it with blank cells. Stores whether the
+ * line continues in the row before. Returns SDL_FALSE if there is no line to
+ * take the row from, or the newest line can no longer be changed.
+ */
+extern SDL_bool history_pop(
+    struct History *history, VTermScreenCell *cells, int cols,
+    const VTermScreenCell *blank, SDL_bool *continuation
+);
+
+/**
+ * Returns the number of lines in the scrollback buffer.
+ */
+extern size_t history_length(const struct History *history);
+
+/**
+ * Returns a line by its index, counted from the oldest line. The line may
+ * live in a mapping of the spill file and is only valid until the next call.
+ * Looking up the line after the previous one is cheapest.
+ */
+extern const struct HistoryLine* history_get(struct History *history, size_t index);
+
+/**
+ * Searches the lines for the text, starting at the given index and moving
+ * towards older lines if backward is set or newer ones otherwise. Returns
+ * the index of the first line containing the text or (size_t)-1. Blocks of
+ * lines whose index rules out the text are skipped without decoding them.
+ */
+extern size_t history_search(
+    struct History *history, const char *text, size_t length, size_t index, SDL_bool backward
+);
+
+/**
+ * A snapshot of the lines in the scrollback buffer, to be read on another
+ * thread while the buffer goes on changing
+ */
+struct HistorySnapshot;
+
+/**
+ * Takes a snapshot of the lines currently in the scrollback buffer. Slabs
+ * holding its lines are kept in the buffer until the snapshot is freed,
+ * even once their lines were evicted. Returns NULL if there already is a
+ * snapshot of the buffer.
+ */
+extern struct HistorySnapshot* history_snapshot(struct History *history);
+
+/**
+ * Returns the next line of the snapshot, from the oldest one on, or NULL
+ * after the last one. May be called on any thread; the line is valid until
+ * the next call.
+ */
+extern const struct HistoryLine* history_snapshot_next(struct HistorySnapshot *snapshot);
+
+/**
+ * Frees the snapshot. Must be called on the thread pushing to the buffer.
+ */
+extern void history_snapshot_free(struct HistorySnapshot *snapshot);
+
+/**
+ * Reports the memory usage of the scrollback buffer.
+ */
+extern void history_statistics(struct History *history, struct HistoryStatistics *statistics);
+
+#endif /* SDLTERM_HISTORY_H */
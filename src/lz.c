@@ -0,0 +1,166 @@
+#include <SDL2/SDL.h>
+#include <iso646.h>
+#include "lz.h"
+
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_WINDOW    65535
+
+static Uint32 read32(const Uint8 *p) {
+    Uint32 value;
+    SDL_memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static Uint32 hash32(Uint32 value) {
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * Writes a length exceeding its 4-bit token field as a run of 255 bytes
+ * and a final byte below 255
+ */
+static SDL_bool write_length(Uint8 **out, const Uint8 *end, size_t length) {
+    for (; length >= 255; length -= 255) {
+        if (*out == end) {
+            return SDL_FALSE;
+        }
+        *(*out)++ = 255;
+    }
+    if (*out == end) {
+        return SDL_FALSE;
+    }
+    *(*out)++ = length;
+    return SDL_TRUE;
+}
+
+/**
+ * Emits a sequence of literals, followed by a match unless length is 0
+ */
+static SDL_bool write_sequence(
+    Uint8 **out, const Uint8 *end, const Uint8 *literals, size_t count,
+    size_t offset, size_t length
+) {
+    if (*out == end) {
+        return SDL_FALSE;
+    }
+    Uint8 *token = (*out)++;
+    size_t match = length ? length - LZ_MIN_MATCH : 0;
+    *token = (count < 15 ? count : 15) << 4 | (match < 15 ? match : 15);
+    if (count >= 15 and not write_length(out, end, count - 15)) {
+        return SDL_FALSE;
+    }
+    if ((size_t)(end - *out) < count) {
+        return SDL_FALSE;
+    }
+    SDL_memcpy(*out, literals, count);
+    *out += count;
+    if (length == 0) {
+        return SDL_TRUE;
+    }
+    if (end - *out < 2) {
+        return SDL_FALSE;
+    }
+    *(*out)++ = offset & 0xff;
+    *(*out)++ = offset >> 8;
+    return match < 15 or write_length(out, end, match - 15);
+}
+
+size_t lz_compress(const void *src, size_t length, void *dst, size_t capacity) {
+    const Uint8 *in = src;
+    Uint8 *out = dst;
+    const Uint8 *end = out + capacity;
+    Uint32 *table = SDL_calloc(1 << LZ_HASH_BITS, sizeof(*table));
+    size_t anchor = 0, position = 0;
+    SDL_bool fits = SDL_TRUE;
+    while (fits and position + LZ_MIN_MATCH <= length) {
+        Uint32 sequence = read32(in + position);
+        Uint32 *entry = &table[hash32(sequence)];
+        size_t candidate = *entry;
+        *entry = position + 1;
+        if (
+            candidate == 0 or position - (candidate - 1) > LZ_WINDOW or
+            read32(in + candidate - 1) != sequence
+        ) {
+            position++;
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t found = LZ_MIN_MATCH;
+        while (position + found < length and in[match + found] == in[position + found]) {
+            found++;
+        }
+        fits = write_sequence(
+            &out, end, in + anchor, position - anchor, position - match, found
+        );
+        position += found;
+        anchor = position;
+    }
+    SDL_free(table);
+    if (not fits or not write_sequence(&out, end, in + anchor, length - anchor, 0, 0)) {
+        return 0;
+    }
+    return out - (Uint8*)dst;
+}
+
+/**
+ * Reads the continuation bytes of a length whose token field is saturated
+ */
+static SDL_bool read_length(const Uint8 **in, const Uint8 *end, size_t *length) {
+    Uint8 byte;
+    do {
+        if (*in == end) {
+            return SDL_FALSE;
+        }
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return SDL_TRUE;
+}
+
+size_t lz_decompress(const void *src, size_t length, void *dst, size_t size) {
+    const Uint8 *in = src;
+    const Uint8 *in_end = in + length;
+    Uint8 *out = dst;
+    Uint8 *out_end = out + size;
+    while (in < in_end) {
+        Uint8 token = *in++;
+        size_t count = token >> 4;
+        if (count == 15 and not read_length(&in, in_end, &count)) {
+            return (size_t)-1;
+        }
+        if ((size_t)(in_end - in) < count or (size_t)(out_end - out) < count) {
+            return (size_t)-1;
+        }
+        SDL_memcpy(out, in, count);
+        in += count;
+        out += count;
+        if (in == in_end) {
+            break;
+        }
+        if (in_end - in < 2) {
+            return (size_t)-1;
+        }
+        size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        size_t match = token & 15;
+        if (match == 15 and not read_length(&in, in_end, &match)) {
+            return (size_t)-1;
+        }
+        match += LZ_MIN_MATCH;
+        if (offset == 0 or offset > (size_t)(out - (Uint8*)dst) or (size_t)(out_end - out) < match) {
+            return (size_t)-1;
+        }
+        /* Matches may overlap their own output, then copy bytewise */
+        const Uint8 *from = out - offset;
+        if (offset >= match) {
+            SDL_memcpy(out, from, match);
+        } else {
+            for (size_t i = 0; i < match; i++) {
+                out[i] = from[i];
+            }
+        }
+        out += match;
+    }
+    return out - (Uint8*)dst;
+}
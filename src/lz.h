@@ -0,0 +1,25 @@
+#ifndef SDLTERM_LZ_H
+#define SDLTERM_LZ_H
+
+#include <SDL2/SDL.h>
+
+/**
+ * A small LZ77 codec in the spirit of LZ4: sequences of literals followed
+ * by a back-reference of at least four bytes within a 64 KiB window. It
+ * trades ratio for speed, which suits the repetitive text of scrollback.
+ */
+
+/**
+ * Compresses length bytes of src into dst. Returns the compressed size or 0
+ * if the result would not fit into capacity bytes.
+ */
+extern size_t lz_compress(const void *src, size_t length, void *dst, size_t capacity);
+
+/**
+ * Decompresses length bytes of src into dst, which holds size bytes.
+ * Returns the decompressed size or (size_t)-1 if the input is malformed or
+ * does not fit.
+ */
+extern size_t lz_decompress(const void *src, size_t length, void *dst, size_t size);
+
+#endif /* SDLTERM_LZ_H */
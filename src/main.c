@@ -18,9 +18,13 @@
 /* Platform-specific includes */
 #if defined(__LINUX__)
 #  include <getopt.h>
+#  include <errno.h>
+#  include <poll.h>
 #  include <pty.h>
 #  include <signal.h>
+#  include <sys/eventfd.h>
 #  include <sys/fcntl.h>
+#  include <sys/syscall.h>
 #  include <sys/types.h>
 #  include <sys/wait.h>
 #  include <termios.h>
@@ -31,10 +35,16 @@
 
 /* Local includes */
 #include "ini.h"
+#include "history.h"
+#include "export.h"
 #include "sdlfox.h"
+#include "uring.h"
 
 /* Macros and Defines */
 #define SDLTERM_VERSION "0.3.1"
+#define SDLTERM_SELECT_INTERVAL 50 /* ms between auto-scroll steps of a selection */
+#define SDLTERM_PASTE_RESERVE 1024 /* queue bytes a paste leaves to key input */
+#define SDLTERM_PASTE_END "\x1b[201~" /* ends a bracketed paste */
 
 /******************************************************************************
  * Data Structure Definitions and Global Variables
@@ -78,6 +88,19 @@ static Uint16 pixels[16*16] = {
     0x0fff, 0x0fff, 0x0fff, 0x0fff, 0x0fff, 0x0fff, 0x0fff, 0x0fff
 };
 
+/**
+ * Deadlines the event loop sleeps until
+ */
+enum TerminalTimer {
+    TIMER_CURSOR,
+    TIMER_BELL,
+    TIMER_RESIZE,
+    TIMER_FRAME,
+    TIMER_SYNC,
+    TIMER_SELECT,
+    NUM_TIMERS
+};
+
 /**
  * The global Terminal Emulator instance
  */
@@ -86,6 +109,9 @@ static struct TerminalEmulator {
     SDL_Window   *window;
     SDL_Cursor   *pointer;
     SDL_Renderer *renderer;
+    SDL_Texture  *texture;
+    SDL_Texture  *scratch;
+    SDL_Texture  *above;
 
     VTerm        *vterm;
     VTermScreen  *screen;
@@ -101,40 +127,112 @@ static struct TerminalEmulator {
     } font;
 
     struct TerminalHistory {
-        struct TerminalHistoryItem {
-            VTermScreenCell *line;
-            unsigned int     length;
-        } *elements;
-        size_t   size;
-        size_t   length;
-        size_t   offset;
+        struct History  *lines;
+        VTermScreenCell *row;
+        int      cols;
+        VTermScreenCell *cells;    /* the scrollback line decoded last */
+        int      capacity;
+        int      count;
+        size_t   decoded;          /* its index or (size_t)-1 */
+        struct TerminalAnchor {
+            size_t line; /* scrollback lines followed by the screen */
+            int    row;  /* row of the line wrapped at the terminal width */
+        } top;                     /* top row of the view */
+        struct TerminalAnchor above; /* row rendered into the texture above */
+        int      pixels; /* the view is shifted down by this fraction of a row */
+        float    scroll; /* wheel pixels not yet applied to the top row */
         SDL_bool infinite;
     } history;
 
     struct TerminalProcess {
         pid_t    pid;
         int      fd;
+        int      pidfd;
         SDL_bool running;
+        SDL_bool pending;
+        volatile sig_atomic_t exited;
+        struct Uring *uring;
     } process;
 
+    struct TerminalWatcher {
+        SDL_Thread  *thread;
+        SDL_sem     *arm;
+        SDL_atomic_t armed;
+        SDL_atomic_t events;
+        SDL_atomic_t quit;
+        Uint32       event;
+        int          wakefd;
+        volatile sig_atomic_t signalled;
+    } watcher;
+
+    struct TerminalScheduler {
+        struct TerminalDeadline {
+            Uint32 ticks;
+            int    timer;
+        } heap[NUM_TIMERS];
+        int position[NUM_TIMERS];
+        int length;
+    } scheduler;
+
+    struct TerminalQueue {
+        char   *buffer;
+        size_t  capacity;
+        size_t  start;
+        size_t  length;
+        char   *retired; /* buffer an io_uring write still reads from */
+    } queue;
+
+    struct TerminalPaste {
+        char   *data;
+        size_t  length;
+        size_t  offset;
+        Uint32  ticks;
+    } paste;
+
+    struct TerminalSearch {
+        SDL_bool active;
+        SDL_bool found;
+        char     query[256];
+        size_t   length;
+        size_t   line;    /* history lines followed by the screen rows */
+        char    *text;    /* UTF-8 text of a row being highlighted */
+        int     *columns; /* column of each byte of the text */
+        size_t   capacity;
+    } search;
+
     struct TerminalBell {
         SDL_bool active;
-        Uint32   ticks;
     } bell;
 
+    struct TerminalExport {
+        struct Export *job;
+        volatile sig_atomic_t requested;
+    } export;
+
     struct MouseState {
         SDL_Point position;
         VTermPos  cell;
         SDL_bool  lmb;
         SDL_bool  rmb;
         SDL_bool  mmb;
-        VTermRect rect;
+        struct TerminalPoint {
+            size_t line; /* scrollback lines followed by the screen rows */
+            int    cell; /* cell of the scrollback line or screen column */
+        } start, end;    /* selection while the left button is held */
+        char     *text;  /* selected text being copied */
+        size_t    length;
+        size_t    capacity;
     } mouse;
 
+    struct TerminalCache {
+        VTermScreenCell *cells;
+        int rows;
+        int cols;
+    } cache;
+
     struct TerminalCursor {
         SDL_Point cell;
         SDL_bool  visible;
-        Uint32    ticks;
     } cursor;
 
     struct {
@@ -142,6 +240,39 @@ static struct TerminalEmulator {
         VTermRect rect;
     } batch;
 
+    struct TerminalFrame {
+        Uint32 ticks;
+        Uint32 interval;
+        size_t bytes;
+    } frame;
+
+    struct TerminalPresent {
+        SDL_bool pending;
+        Uint32   due;
+        Uint32   ticks;
+        Uint32   start;
+        Uint32   frames;
+        Uint32   dropped;
+    } present;
+
+    struct TerminalSync {
+        SDL_bool active;
+        Uint32   ticks;
+    } sync;
+
+    struct TerminalLatency {
+        Uint64   input;
+        SDL_bool echoed;
+        struct LatencyHistogram {
+            Uint32 buckets[12];
+            Uint32 samples;
+            double total;
+            double max;
+        } echo, present;
+    } latency;
+
+    volatile sig_atomic_t statistics;
+
     int x;
     int y;
     int width;
@@ -152,6 +283,7 @@ static struct TerminalEmulator {
     Uint32   ticks;
     Uint32   ticks_resize;
     SDL_bool fullscreen;
+    SDL_bool hidden;
     SDL_bool dirty;
 
 } terminal;
@@ -169,17 +301,24 @@ static struct TerminalEmulatorConfiguration {
         int   width;
         int   height;
         int   timeout;
+        int   fps;
+        SDL_bool vsync;
         Uint32 flags;
     } window;
 
     struct {
         char  *cmdline;
         char **arguments;
+        size_t queue;
+        size_t jumpscroll;
+        Uint32 synctimeout;
+        SDL_bool uring;
     } process;
 
     struct {
         SDL_LogPriority priority;
         SDL_bool enabled;
+        SDL_bool statistics;
     } logging;
 
     struct {
@@ -198,6 +337,11 @@ static struct TerminalEmulatorConfiguration {
         SDL_bool enable;
     } history;
 
+    struct {
+        char *path;
+        enum ExportFormat format;
+    } export;
+
 } configuration;
 
 /**
@@ -229,6 +373,34 @@ static void set_config_cmdline(const char *value) {
 	}
 }
 
+static void set_config_queue(const char *value) {
+    if (value != NULL) {
+        configuration.process.queue = SDL_strtol(value, NULL, 10);
+        SDL_Log("configuration.process.queue = %s", value);
+    }
+}
+
+static void set_config_engine(const char *value) {
+    if (value != NULL) {
+        configuration.process.uring = !SDL_strcmp(value, "uring");
+        SDL_Log("configuration.process.engine = %s", value);
+    }
+}
+
+static void set_config_jumpscroll(const char *value) {
+    if (value != NULL) {
+        configuration.process.jumpscroll = SDL_strtol(value, NULL, 10);
+        SDL_Log("configuration.process.jumpscroll = %s", value);
+    }
+}
+
+static void set_config_synctimeout(const char *value) {
+    if (value != NULL) {
+        configuration.process.synctimeout = SDL_strtol(value, NULL, 10);
+        SDL_Log("configuration.process.synctimeout = %s", value);
+    }
+}
+
 static void set_config_window_title(const char *value) {
 	if (value != NULL) {
 		configuration.window.title = SDL_strdup(value);
@@ -334,6 +506,13 @@ static void set_config_logging_priority(const char *value) {
     }
 }
 
+static void set_config_logging_statistics(const char *value) {
+    if (value != NULL) {
+        configuration.logging.statistics = !SDL_strcmp(value, "true");
+        SDL_Log("configuration.logging.statistics = %s", value);
+    }
+}
+
 static void set_config_timeout(const char *value) {
     if (value != NULL) {
         configuration.window.timeout = SDL_strtol(value, NULL, 10);
@@ -341,6 +520,20 @@ static void set_config_timeout(const char *value) {
     }
 }
 
+static void set_config_fps(const char *value) {
+    if (value != NULL) {
+        configuration.window.fps = SDL_strtol(value, NULL, 10);
+        SDL_Log("configuration.window.fps = %s", value);
+    }
+}
+
+static void set_config_vsync(const char *value) {
+    if (value != NULL) {
+        configuration.window.vsync = !SDL_strcmp(value, "true");
+        SDL_Log("configuration.window.vsync = %s", value);
+    }
+}
+
 static void set_config_cursor_interval(const char *value) {
     if (value != NULL) {
         configuration.cursor.interval = SDL_strtol(value, NULL, 10);
@@ -363,10 +556,28 @@ static void set_config_history_limit(const char *value) {
     }
 }
 
+static void set_config_export_path(const char *value) {
+    if (value != NULL) {
+        configuration.export.path = SDL_strdup(value);
+        SDL_Log("configuration.export.path = %s", value);
+    }
+}
+
+static void set_config_export_format(const char *value) {
+    if (value != NULL) {
+        configuration.export.format = !SDL_strcmp(value, "sgr") ? EXPORT_SGR : EXPORT_PLAIN;
+        SDL_Log("configuration.export.format = %s", value);
+    }
+}
+
 static void load_sdlterm_configuration_file(void) {
     struct IniFile *ini = ini_load_file(sdlterm_config_path);
     if (ini != NULL) {
         set_config_cmdline(ini_get_value(ini, "terminal", "cmdline"));
+        set_config_queue(ini_get_value(ini, "terminal", "queue"));
+        set_config_engine(ini_get_value(ini, "terminal", "engine"));
+        set_config_jumpscroll(ini_get_value(ini, "terminal", "jumpscroll"));
+        set_config_synctimeout(ini_get_value(ini, "terminal", "synctimeout"));
         set_config_window_title(ini_get_value(ini, "window", "title"));
         set_config_window_width(ini_get_value(ini, "window", "width"));
         set_config_window_height(ini_get_value(ini, "window", "height"));
@@ -376,13 +587,18 @@ static void load_sdlterm_configuration_file(void) {
 		set_config_window_ontop(ini_get_value(ini, "window", "ontop"));
         set_config_renderer(ini_get_value(ini, "window", "renderer"));
         set_config_timeout(ini_get_value(ini, "window", "timeout"));
+        set_config_fps(ini_get_value(ini, "window", "fps"));
+        set_config_vsync(ini_get_value(ini, "window", "vsync"));
         set_config_font_path(ini_get_value(ini, "font", "path"));
         set_config_font_size(ini_get_value(ini, "font", "ptsize"));
         set_config_logging_enabled(ini_get_value(ini, "logging", "enabled"));
         set_config_logging_priority(ini_get_value(ini, "logging", "priority"));
+        set_config_logging_statistics(ini_get_value(ini, "logging", "statistics"));
         set_config_cursor_interval(ini_get_value(ini, "cursor", "interval"));
         set_config_history_enabled(ini_get_value(ini, "history", "enabled"));
         set_config_history_limit(ini_get_value(ini, "history", "limit"));
+        set_config_export_path(ini_get_value(ini, "export", "path"));
+        set_config_export_format(ini_get_value(ini, "export", "format"));
         ini_free_file(ini);
     } else {
         fprintf(stderr, "ERROR: Failed to load sdlterm configuration file: %s\n", sdlterm_config_path);
@@ -394,6 +610,7 @@ static void free_sdlterm_configuration(void) {
     SDL_free(configuration.font.path);
     SDL_free(configuration.process.cmdline);
     SDL_free(configuration.window.title);
+    SDL_free(configuration.export.path);
 }
 
 /******************************************************************************
@@ -496,15 +713,178 @@ static int map_to_x(int col) {
     return col * FOX_GlyphWidth(terminal.font.regular);
 }
 
+/**
+ * Returns the cell last rendered at the given position or NULL if the
+ * position lies outside of the cache
+ */
+static VTermScreenCell* cached_terminal_cell(VTermPos position) {
+    if (
+        position.row < 0 or position.row >= terminal.cache.rows or
+        position.col < 0 or position.col >= terminal.cache.cols
+    ) {
+        return NULL;
+    }
+    return &terminal.cache.cells[position.row * terminal.cache.cols + position.col];
+}
+
+/**
+ * Marks the cached cell at the given position as unknown, so it is rendered
+ * again no matter its contents
+ */
+static void invalidate_terminal_cell(VTermPos position) {
+    VTermScreenCell *cached = cached_terminal_cell(position);
+    if (cached != NULL) {
+        SDL_memset(cached, 0xff, sizeof(*cached));
+    }
+}
+
+/**
+ * Resizes the rendered cell cache to the terminal dimensions, keeping the
+ * overlapping region and invalidating newly exposed cells
+ */
+static void resize_terminal_cache(void) {
+    VTermScreenCell *cells = SDL_malloc(sizeof(*cells) * terminal.rows * terminal.cols);
+    SDL_memset(cells, 0xff, sizeof(*cells) * terminal.rows * terminal.cols);
+    for (int row = 0; row < SDL_min(terminal.rows, terminal.cache.rows); row++) {
+        SDL_memcpy(
+            &cells[row * terminal.cols],
+            &terminal.cache.cells[row * terminal.cache.cols],
+            sizeof(*cells) * SDL_min(terminal.cols, terminal.cache.cols)
+        );
+    }
+    SDL_free(terminal.cache.cells);
+    terminal.cache.cells = cells;
+    terminal.cache.rows = terminal.rows;
+    terminal.cache.cols = terminal.cols;
+}
+
+/**
+ * Fetches a cell of the vterm screen. The cell is cleared beforehand so that
+ * cells can be compared bytewise with cached ones.
+ */
+static void get_terminal_cell(VTermPos position, VTermScreenCell *cell) {
+    SDL_memset(cell, 0, sizeof(*cell));
+    vterm_screen_get_cell(terminal.screen, position, cell);
+}
+
 /**
  * Clears the screen
  */
 static void clear_terminal_window(void) {
     SDL_SetRenderDrawColor(terminal.renderer, 0, 0, 0, 255);
     SDL_RenderClear(terminal.renderer);
+    SDL_memset(terminal.cache.cells, 0xff, sizeof(*terminal.cache.cells) * terminal.cache.rows * terminal.cache.cols);
+    terminal.dirty = SDL_TRUE;
+}
+
+/**
+ * Recreates the render target texture the terminal is drawn into for the
+ * current window size. The contents of the previous texture are copied
+ * over, so unchanged regions need not be rendered again.
+ */
+static void resize_terminal_texture(void) {
+    SDL_Texture *texture = SDL_CreateTexture(
+        terminal.renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+        terminal.width, terminal.height
+    );
+    SDL_SetRenderTarget(terminal.renderer, texture);
+    SDL_SetRenderDrawColor(terminal.renderer, 0, 0, 0, 255);
+    SDL_RenderClear(terminal.renderer);
+    if (terminal.texture != NULL) {
+        int width, height;
+        SDL_QueryTexture(terminal.texture, NULL, NULL, &width, &height);
+        SDL_Rect rect = {0, 0, SDL_min(width, terminal.width), SDL_min(height, terminal.height)};
+        SDL_RenderCopy(terminal.renderer, terminal.texture, &rect, &rect);
+        SDL_DestroyTexture(terminal.texture);
+        /* Clear partial cells cut off by a shrinking window */
+        SDL_Rect right = {map_to_x(terminal.cols), 0, terminal.width, terminal.height};
+        SDL_Rect bottom = {0, map_to_y(terminal.rows), terminal.width, terminal.height};
+        SDL_RenderFillRect(terminal.renderer, &right);
+        SDL_RenderFillRect(terminal.renderer, &bottom);
+    }
+    terminal.texture = texture;
+    /* The scratch texture is recreated at the new size when next needed */
+    if (terminal.scratch != NULL) {
+        SDL_DestroyTexture(terminal.scratch);
+        terminal.scratch = NULL;
+    }
+    if (terminal.above != NULL) {
+        SDL_DestroyTexture(terminal.above);
+        terminal.above = NULL;
+        terminal.history.above.line = (size_t)-1;
+    }
+    terminal.dirty = SDL_TRUE;
+}
+
+/**
+ * Shifts the rendered rows and their cached cells down by delta rows, or up
+ * if delta is negative. The texture cannot be copied onto itself, so the
+ * rows are copied into a scratch texture which then takes its place. The
+ * rows exposed by the shift are left blank and invalid in the cache.
+ */
+static void scroll_terminal_view(int delta) {
+    int width, height;
+    SDL_QueryTexture(terminal.texture, NULL, NULL, &width, &height);
+    if (terminal.scratch == NULL) {
+        terminal.scratch = SDL_CreateTexture(
+            terminal.renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+            width, height
+        );
+    }
+    int kept = terminal.rows - SDL_abs(delta);
+    SDL_Rect src = {0, map_to_y(SDL_max(-delta, 0)), map_to_x(terminal.cols), map_to_y(kept)};
+    SDL_Rect dst = {0, map_to_y(SDL_max(delta, 0)), src.w, src.h};
+    SDL_SetRenderTarget(terminal.renderer, terminal.scratch);
+    SDL_SetRenderDrawColor(terminal.renderer, 0, 0, 0, 255);
+    SDL_RenderClear(terminal.renderer);
+    SDL_RenderCopy(terminal.renderer, terminal.texture, &src, &dst);
+    SDL_Texture *texture = terminal.texture;
+    terminal.texture = terminal.scratch;
+    terminal.scratch = texture;
+    SDL_SetRenderTarget(terminal.renderer, terminal.texture);
+
+    VTermScreenCell *cells = terminal.cache.cells;
+    size_t row = sizeof(*cells) * terminal.cache.cols;
+    if (delta > 0) {
+        SDL_memmove(cells + delta * terminal.cache.cols, cells, row * kept);
+        SDL_memset(cells, 0xff, row * delta);
+    } else {
+        SDL_memmove(cells, cells - delta * terminal.cache.cols, row * kept);
+        SDL_memset(cells + kept * terminal.cache.cols, 0xff, row * -delta);
+    }
     terminal.dirty = SDL_TRUE;
 }
 
+/**
+ * Copies the render target texture to the window and presents it. While
+ * scrolled by a fraction of a row, the texture is shifted down by it and
+ * the gap at the top is filled from the texture of the row above. The
+ * visual bell is drawn on top as a frame around the cells.
+ */
+static void present_terminal_window(void) {
+    int width, height;
+    SDL_QueryTexture(terminal.texture, NULL, NULL, &width, &height);
+    int shift = terminal.history.pixels;
+    SDL_Rect src = {0, 0, width, height - shift};
+    SDL_Rect dst = {0, shift, width, height - shift};
+    SDL_SetRenderTarget(terminal.renderer, NULL);
+    SDL_SetRenderDrawColor(terminal.renderer, 0, 0, 0, 255);
+    SDL_RenderClear(terminal.renderer);
+    SDL_RenderCopy(terminal.renderer, terminal.texture, &src, &dst);
+    if (shift > 0 and terminal.above != NULL) {
+        SDL_Rect rowsrc = {0, map_to_y(1) - shift, width, shift};
+        SDL_Rect rowdst = {0, 0, width, shift};
+        SDL_RenderCopy(terminal.renderer, terminal.above, &rowsrc, &rowdst);
+    }
+    if (terminal.bell.active) {
+        SDL_Rect frame = {0, 0, map_to_x(terminal.cols), map_to_y(terminal.rows)};
+        SDL_SetRenderDrawColor(terminal.renderer, 255, 255, 255, 255);
+        SDL_RenderDrawRect(terminal.renderer, &frame);
+    }
+    SDL_RenderPresent(terminal.renderer);
+    SDL_SetRenderTarget(terminal.renderer, terminal.texture);
+}
+
 /**
  * Fills the terminal cell with the given color
  */
@@ -521,9 +901,9 @@ static void flood_cell(VTermPos position, SDL_Color color) {
 }
 
 /**
- * Renders the current terminal cell at the given position
+ * Draws a terminal cell at the given pixel coordinates
  */
-static void render_terminal_cell(VTermScreenCell *cell, VTermPos position) {
+static void draw_terminal_cell(VTermScreenCell *cell, int x, int y) {
     Uint32 character = cell->chars[0];
     FOX_Font *font = terminal.font.regular;
     vterm_state_convert_color_to_rgb(terminal.state, &cell->fg);
@@ -536,161 +916,1369 @@ static void render_terminal_cell(VTermScreenCell *cell, VTermPos position) {
     } else if (cell->attrs.underline) {
         font = terminal.font.underline;
     }
-    
-    if (cell->attrs.reverse) {
-		fgcolor.r = ~fgcolor.r; fgcolor.g = ~fgcolor.g; fgcolor.b = ~fgcolor.b;
-		bgcolor.r = ~bgcolor.r; bgcolor.g = ~bgcolor.g; bgcolor.b = ~bgcolor.b;
-	}
+    
+    if (cell->attrs.reverse) {
+		fgcolor.r = ~fgcolor.r; fgcolor.g = ~fgcolor.g; fgcolor.b = ~fgcolor.b;
+		bgcolor.r = ~bgcolor.r; bgcolor.g = ~bgcolor.g; bgcolor.b = ~bgcolor.b;
+	}
+
+    SDL_Rect dstrect = {
+        x, y, FOX_GlyphWidth(terminal.font.regular), FOX_GlyphHeight(terminal.font.regular)
+    };
+    SDL_SetRenderDrawColor(terminal.renderer, bgcolor.r, bgcolor.g, bgcolor.b, 255);
+    SDL_RenderFillRect(terminal.renderer, &dstrect);
+    SDL_Point coordinates = {x, y};
+    SDL_SetRenderDrawColor(terminal.renderer, fgcolor.r, fgcolor.g, fgcolor.b, 255);
+    FOX_DrawGlyph(font, &coordinates, character);
+    terminal.dirty = SDL_TRUE;
+}
+
+/**
+ * Renders the current terminal cell at the given position
+ */
+static void render_terminal_cell(VTermScreenCell *cell, VTermPos position) {
+    VTermScreenCell *cached = cached_terminal_cell(position);
+    if (cached != NULL) {
+        if (not SDL_memcmp(cached, cell, sizeof(*cell))) {
+            return;
+        }
+        *cached = *cell;
+    }
+    draw_terminal_cell(cell, map_to_x(position.col), map_to_y(position.row));
+}
+
+/**
+ * Returns the row buffer, grown to the terminal width if necessary. It is
+ * shared by screen rows and decoded scrollback lines.
+ */
+static VTermScreenCell* reserve_terminal_row(void) {
+    if (terminal.history.cols < terminal.cols) {
+        terminal.history.cols = terminal.cols;
+        terminal.history.row = SDL_realloc(
+            terminal.history.row, sizeof(*terminal.history.row) * terminal.cols
+        );
+    }
+    return terminal.history.row;
+}
+
+/**
+ * Fetches a whole row of the vterm screen into the row buffer
+ */
+static VTermScreenCell* fetch_terminal_row(int row) {
+    VTermScreenCell *cells = reserve_terminal_row();
+    VTermPos position = {.row = row};
+    for (position.col = 0; position.col < terminal.cols; position.col++) {
+        get_terminal_cell(position, &cells[position.col]);
+    }
+    return cells;
+}
+
+/**
+ * Collects the UTF-8 text of a row of cells into the search buffer and
+ * records the column each byte belongs to. Blank cells read as spaces like
+ * in scrollback lines. Returns the length of the text.
+ */
+static size_t collect_terminal_text(const VTermScreenCell *cells, int cols) {
+    struct TerminalSearch *search = &terminal.search;
+    size_t capacity = (size_t)cols * VTERM_MAX_CHARS_PER_CELL * 4;
+    if (search->capacity < capacity) {
+        search->capacity = capacity;
+        search->text = SDL_realloc(search->text, capacity);
+        search->columns = SDL_realloc(search->columns, sizeof(*search->columns) * capacity);
+    }
+    size_t length = 0;
+    for (int col = 0; col < cols; col++) {
+        const VTermScreenCell *cell = &cells[col];
+        if (cell->chars[0] == (uint32_t)-1) {
+            /* Second half of a wide character */
+            continue;
+        }
+        char *start = &search->text[length];
+        if (cell->chars[0] == 0) {
+            search->text[length++] = ' ';
+        }
+        for (int i = 0; i < VTERM_MAX_CHARS_PER_CELL and cell->chars[i] != 0; i++) {
+            length += history_encode_char(cell->chars[i], &search->text[length]);
+        }
+        for (; start < &search->text[length]; start++) {
+            search->columns[start - search->text] = col;
+        }
+    }
+    return length;
+}
+
+/**
+ * Reverses the cells of all matches of the search query in the row
+ */
+static void highlight_terminal_matches(VTermScreenCell *cells, int cols) {
+    struct TerminalSearch *search = &terminal.search;
+    if (not search->active or search->length == 0) {
+        return;
+    }
+    size_t length = collect_terminal_text(cells, cols);
+    const char *text = search->text;
+    const char *end = search->text + length;
+    const char *match;
+    for (; (match = history_find_text(text, end - text, search->query, search->length)); text = match + search->length) {
+        int col = search->columns[match - search->text];
+        int last = search->columns[match - search->text + search->length - 1];
+        for (; col <= last or (col < cols and cells[col].chars[0] == (uint32_t)-1); col++) {
+            cells[col].attrs.reverse = !cells[col].attrs.reverse;
+        }
+    }
+}
+
+/**
+ * Orders two selection points, returning a negative number if a comes first
+ */
+static int compare_terminal_points(struct TerminalPoint a, struct TerminalPoint b) {
+    if (a.line != b.line) {
+        return a.line < b.line ? -1 : 1;
+    }
+    return a.cell - b.cell;
+}
+
+/**
+ * Reverses the cells of the row that lie within the selection. The row holds
+ * the cells of the given line starting at the given cell.
+ */
+static void highlight_terminal_selection(VTermScreenCell *cells, int cols, size_t line, int first) {
+    struct MouseState *mouse = &terminal.mouse;
+    if (not mouse->lmb) {
+        return;
+    }
+    struct TerminalPoint from = mouse->start, to = mouse->end;
+    if (compare_terminal_points(from, to) > 0) {
+        from = mouse->end;
+        to = mouse->start;
+    }
+    if (line < from.line or line > to.line) {
+        return;
+    }
+    int col = line == from.line ? SDL_max(from.cell - first, 0) : 0;
+    int last = line == to.line ? to.cell - first : cols - 1;
+    for (; col < cols and (col <= last or cells[col].chars[0] == (uint32_t)-1); col++) {
+        cells[col].attrs.reverse = !cells[col].attrs.reverse;
+    }
+}
+
+/**
+ * Renders the whole screen of current vterm cells
+ */
+static void render_terminal_rect(VTermRect *rect) {
+    VTermPos position;
+    for (position.row = rect->start_row; position.row < rect->end_row; position.row++) {
+        if (terminal.search.active or terminal.mouse.lmb) {
+            /* Matches and the selection are highlighted on whole rows */
+            VTermScreenCell *cells = fetch_terminal_row(position.row);
+            highlight_terminal_matches(cells, terminal.cols);
+            size_t line = history_length(terminal.history.lines) + position.row;
+            highlight_terminal_selection(cells, terminal.cols, line, 0);
+            for (position.col = rect->start_col; position.col < rect->end_col; position.col++) {
+                render_terminal_cell(&cells[position.col], position);
+            }
+            continue;
+        }
+		for (position.col = rect->start_col; position.col < rect->end_col; position.col++) {
+            VTermScreenCell cell;
+            get_terminal_cell(position, &cell);
+			render_terminal_cell(&cell, position);
+		}
+	}
+}
+
+/**
+ * Renders the whole screen of current vterm cells
+ */
+static void render_terminal_screen(void) {
+    VTermRect rect = {
+        .start_col = 0,
+        .start_row = 0,
+        .end_col = terminal.cols,
+        .end_row = terminal.rows
+    };
+    render_terminal_rect(&rect);
+}
+
+/**
+ * Returns a blank cell in the default colors
+ */
+static VTermScreenCell blank_terminal_cell(void) {
+    VTermScreenCell blank;
+    SDL_zero(blank);
+    blank.width = 1;
+    vterm_state_get_default_colors(terminal.state, &blank.fg, &blank.bg);
+    return blank;
+}
+
+/**
+ * Decodes a whole scrollback line and highlights the search matches in it,
+ * which may span several of its wrapped rows. The line stays decoded while
+ * its rows are rendered, until the scrollback buffer changes or the whole
+ * view is rendered again.
+ */
+static VTermScreenCell* decode_terminal_line(size_t index) {
+    struct TerminalHistory *history = &terminal.history;
+    if (history->decoded == index) {
+        return history->cells;
+    }
+    const struct HistoryLine *line = history_get(history->lines, index);
+    int cells = history_line_cells(line);
+    if (history->capacity < cells) {
+        history->capacity = cells;
+        history->cells = SDL_realloc(history->cells, sizeof(*history->cells) * cells);
+    }
+    VTermScreenCell blank = blank_terminal_cell();
+    history->count = history_decode_line(line, history->cells, cells, &blank);
+    highlight_terminal_matches(history->cells, history->count);
+    history->decoded = index;
+    return history->cells;
+}
+
+/**
+ * Returns the number of rows the scrollback line takes in the view
+ */
+static int terminal_line_rows(size_t index) {
+    return history_line_rows(history_get(terminal.history.lines, index), terminal.cols);
+}
+
+/**
+ * Moves the anchor one row down, through the wrapped rows of the scrollback
+ * lines and on into the screen. Returns SDL_FALSE at the last screen row.
+ */
+static SDL_bool next_terminal_row(struct TerminalAnchor *anchor) {
+    size_t length = history_length(terminal.history.lines);
+    if (anchor->line < length and anchor->row + 1 < terminal_line_rows(anchor->line)) {
+        anchor->row++;
+    } else if (anchor->line < length) {
+        anchor->line++;
+        anchor->row = 0;
+    } else if (anchor->row + 1 < terminal.rows) {
+        anchor->row++;
+    } else {
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+/**
+ * Moves the anchor one row up. Returns SDL_FALSE at the first row of the
+ * oldest scrollback line.
+ */
+static SDL_bool previous_terminal_row(struct TerminalAnchor *anchor) {
+    if (anchor->row > 0) {
+        anchor->row--;
+    } else if (anchor->line == 0) {
+        return SDL_FALSE;
+    } else {
+        anchor->line--;
+        anchor->row = terminal_line_rows(anchor->line) - 1;
+    }
+    return SDL_TRUE;
+}
+
+/**
+ * Fetches the row of the view at the anchor into the row buffer: a wrapped
+ * row of a scrollback line or a screen row, with search matches and the
+ * selection highlighted
+ */
+static VTermScreenCell* fetch_terminal_view_row(struct TerminalAnchor anchor) {
+    if (anchor.line >= history_length(terminal.history.lines)) {
+        VTermScreenCell *row = fetch_terminal_row(anchor.row);
+        highlight_terminal_matches(row, terminal.cols);
+        highlight_terminal_selection(row, terminal.cols, anchor.line + anchor.row, 0);
+        return row;
+    }
+    VTermScreenCell *cells = decode_terminal_line(anchor.line);
+    const struct HistoryLine *line = history_get(terminal.history.lines, anchor.line);
+    int start = history_line_wrap(line, terminal.cols, anchor.row);
+    int end = SDL_min(history_line_wrap(line, terminal.cols, anchor.row + 1), terminal.history.count);
+    VTermScreenCell *row = reserve_terminal_row();
+    VTermScreenCell blank = blank_terminal_cell();
+    for (int col = 0; col < terminal.cols; col++) {
+        row[col] = start + col < end ? cells[start + col] : blank;
+    }
+    highlight_terminal_selection(row, terminal.cols, anchor.line, start);
+    return row;
+}
+
+/**
+ * Renders the given rows of the view, starting with the top row anchored in
+ * the scrollback buffer and going on with as many screen rows as fit
+ */
+static void render_terminal_view(int start_row, int end_row) {
+    struct TerminalAnchor anchor = terminal.history.top;
+    for (int row = 0; row < start_row; row++) {
+        next_terminal_row(&anchor);
+    }
+    VTermPos pos;
+    for (pos.row = start_row; pos.row < end_row; pos.row++, next_terminal_row(&anchor)) {
+        VTermScreenCell *row = fetch_terminal_view_row(anchor);
+        for (pos.col = 0; pos.col < terminal.cols; pos.col++) {
+            render_terminal_cell(&row[pos.col], pos);
+        }
+    }
+}
+
+/**
+ * Renders the row above the view into its own texture, from which the
+ * window is filled while scrolled by a fraction of a row. The row is only
+ * rendered again once another one moved above the view.
+ */
+static void render_terminal_above(void) {
+    struct TerminalAnchor above = terminal.history.top;
+    if (terminal.history.pixels == 0 or not previous_terminal_row(&above)) {
+        return;
+    } else if (above.line == terminal.history.above.line and above.row == terminal.history.above.row) {
+        return;
+    }
+    if (terminal.above == NULL) {
+        terminal.above = SDL_CreateTexture(
+            terminal.renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+            terminal.width, map_to_y(1)
+        );
+    }
+    SDL_SetRenderTarget(terminal.renderer, terminal.above);
+    SDL_SetRenderDrawColor(terminal.renderer, 0, 0, 0, 255);
+    SDL_RenderClear(terminal.renderer);
+    VTermScreenCell *row = fetch_terminal_view_row(above);
+    for (int col = 0; col < terminal.cols; col++) {
+        draw_terminal_cell(&row[col], map_to_x(col), 0);
+    }
+    SDL_SetRenderTarget(terminal.renderer, terminal.texture);
+    terminal.history.above = above;
+}
+
+/**
+ * Renders the whole view from its top row. Lines are wrapped at the current
+ * width only here, so the top row is moved back onto its line if the line
+ * takes fewer rows now.
+ */
+static void render_terminal_history(void) {
+    struct TerminalHistory *history = &terminal.history;
+    size_t length = history_length(history->lines);
+    if (history->top.line < length) {
+        history->top.row = SDL_min(history->top.row, terminal_line_rows(history->top.line) - 1);
+    } else {
+        history->top.line = length;
+        history->top.row = 0;
+    }
+    history->above.line = (size_t)-1;
+    history->decoded = (size_t)-1;
+    render_terminal_view(0, terminal.rows);
+}
+
+/**
+ * Renders the terminal cell cursor
+ */
+static void render_terminal_cursor(SDL_bool enabled) {
+    VTermPos position = {
+        .col = terminal.cursor.cell.x,
+        .row = terminal.cursor.cell.y
+    };
+    VTermScreenCell cell;
+    get_terminal_cell(position, &cell);
+    if (enabled) {
+        static const SDL_Color color = {255, 255, 255, 255};
+        flood_cell(position, color);
+        invalidate_terminal_cell(position);
+    } else {
+        render_terminal_cell(&cell, position);
+    }
+}
+
+/**
+ * Returns SDL_TRUE while the view is scrolled back into the scrollback
+ * buffer. Screen updates are not rendered then, but accumulated until the
+ * view returns to the bottom.
+ */
+static SDL_bool terminal_scrolled_back(void) {
+    return terminal.history.top.line < history_length(terminal.history.lines)
+        or terminal.history.pixels > 0;
+}
+
+/**
+ * Applies the wheel scrolling accumulated since the last frame. Whole rows
+ * still visible are shifted within the texture and only the exposed ones
+ * are rendered, fractions of a row are applied when presenting.
+ */
+static void render_terminal_scroll(void) {
+    struct TerminalHistory *history = &terminal.history;
+    int height = map_to_y(1);
+    int pixels = history->pixels + (int)history->scroll;
+    history->scroll -= (int)history->scroll;
+    /* Each whole row of the shift moves the top row of the view, until it
+     * reaches the oldest line or the screen */
+    struct TerminalAnchor top = history->top;
+    int delta = 0;
+    for (; pixels >= height; pixels -= height, delta++) {
+        if (not previous_terminal_row(&top)) {
+            break;
+        }
+    }
+    for (; pixels < 0; pixels += height, delta--) {
+        if (top.line >= history_length(history->lines) or not next_terminal_row(&top)) {
+            break;
+        }
+    }
+    struct TerminalAnchor above = top;
+    if (pixels < 0 or (pixels > 0 and not previous_terminal_row(&above))) {
+        pixels = 0;
+        history->scroll = 0;
+    }
+    if (delta == 0 and pixels == history->pixels) {
+        return;
+    }
+    if (not terminal_scrolled_back() and terminal.cursor.visible) {
+        /* Take the cursor off the screen before it would scroll along */
+        render_terminal_cursor(SDL_FALSE);
+    }
+    history->top = top;
+    history->pixels = pixels;
+    terminal.dirty = SDL_TRUE;
+    if (delta == 0) {
+        /* Only the fraction changed */
+    } else if (SDL_abs(delta) >= terminal.rows or terminal.batch.flush) {
+        /* The screen changed while scrolled back, any row may be stale */
+        render_terminal_history();
+    } else if (delta > 0) {
+        scroll_terminal_view(delta);
+        render_terminal_view(0, delta);
+    } else {
+        scroll_terminal_view(delta);
+        render_terminal_view(terminal.rows + delta, terminal.rows);
+    }
+    if (not terminal_scrolled_back()) {
+        render_terminal_cursor(terminal.cursor.visible);
+    }
+}
+
+/**
+ * Returns SDL_TRUE if wheel scrolling of at least a pixel is pending
+ */
+static SDL_bool terminal_scroll_pending(void) {
+    return terminal.history.scroll >= 1 or terminal.history.scroll <= -1;
+}
+
+/**
+ * Returns the number of bytes that can currently be appended to the write
+ * queue. The queued data cannot be compacted while io_uring writes from it.
+ */
+static size_t terminal_queue_space(void) {
+    struct TerminalQueue *queue = &terminal.queue;
+    if (terminal.process.uring != NULL and uring_writing(terminal.process.uring)) {
+        return queue->capacity - queue->start - queue->length;
+    }
+    return queue->capacity - queue->length;
+}
+
+/**
+ * Appends data to the write queue of the terminal child process. Nothing is
+ * queued and SDL_FALSE is returned if the queue cannot hold all of the data.
+ */
+static SDL_bool write_terminal_process(const char *data, size_t length) {
+    struct TerminalQueue *queue = &terminal.queue;
+    if (length > terminal_queue_space()) {
+        SDL_LogWarn(0, "Write queue full, dropping %zu bytes", length);
+        return SDL_FALSE;
+    }
+    if (length > queue->capacity - queue->start - queue->length) {
+        SDL_memmove(queue->buffer, queue->buffer + queue->start, queue->length);
+        queue->start = 0;
+    }
+    SDL_memcpy(queue->buffer + queue->start + queue->length, data, length);
+    queue->length += length;
+    return SDL_TRUE;
+}
+
+/**
+ * Grows the write queue to hold at least the given number of bytes more.
+ * The old buffer is kept until a write still reading from it completed.
+ */
+static void grow_terminal_queue(size_t length) {
+    struct TerminalQueue *queue = &terminal.queue;
+    size_t capacity = SDL_max(queue->capacity * 2, queue->length + length);
+    char *buffer = SDL_malloc(capacity);
+    SDL_memcpy(buffer, queue->buffer + queue->start, queue->length);
+    if (terminal.process.uring != NULL and uring_writing(terminal.process.uring) and queue->retired == NULL) {
+        queue->retired = queue->buffer;
+    } else {
+        SDL_free(queue->buffer);
+    }
+    SDL_LogDebug(0, "Write queue grown to %zu bytes", capacity);
+    queue->buffer = buffer;
+    queue->capacity = capacity;
+    queue->start = 0;
+}
+
+/**
+ * Writes as much of the queue to the terminal child process as the pseudo
+ * terminal accepts without blocking. Queued writes are coalesced into a
+ * single write call.
+ */
+static void flush_terminal_process(void) {
+    struct TerminalQueue *queue = &terminal.queue;
+    if (terminal.process.uring != NULL) {
+        ssize_t length = uring_written(terminal.process.uring);
+        if (length < 0) {
+            SDL_LogDebug(0, "Write queue discarded: io_uring write failed");
+            queue->length = 0;
+        } else {
+            queue->start += length;
+            queue->length -= length;
+        }
+        if (queue->retired != NULL and not uring_writing(terminal.process.uring)) {
+            SDL_free(queue->retired);
+            queue->retired = NULL;
+        }
+        if (queue->length == 0) {
+            queue->start = 0;
+        } else if (not uring_writing(terminal.process.uring)) {
+            uring_write(terminal.process.uring, queue->buffer + queue->start, queue->length);
+        }
+        return;
+    }
+    while (queue->length > 0) {
+        ssize_t length = write(terminal.process.fd, queue->buffer + queue->start, queue->length);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN) {
+                SDL_LogDebug(0, "Write queue discarded: %s", strerror(errno));
+                queue->length = 0;
+            }
+            break;
+        }
+        queue->start += length;
+        queue->length -= length;
+    }
+    if (queue->length == 0) {
+        queue->start = 0;
+    }
+}
+
+/**
+ * Sets the window title, optionally followed by a status text
+ */
+static void set_terminal_title(const char *status) {
+    char title[256] = {0};
+    SDL_strlcat(title, configuration.window.title, sizeof(title));
+    SDL_strlcat(title, ": ", sizeof(title));
+    SDL_strlcat(title, configuration.process.cmdline, sizeof(title));
+    if (status != NULL) {
+        SDL_strlcat(title, " ", sizeof(title));
+        SDL_strlcat(title, status, sizeof(title));
+    }
+    SDL_SetWindowTitle(terminal.window, title);
+}
+
+/**
+ * Ends the current paste operation, discarding any data not yet queued
+ */
+static void finish_terminal_paste(void) {
+    if (terminal.paste.data != NULL) {
+        vterm_keyboard_end_paste(terminal.vterm);
+        if (terminal.paste.offset < terminal.paste.length) {
+            SDL_LogDebug(0, "Paste cancelled after %zu of %zu bytes",
+                terminal.paste.offset, terminal.paste.length);
+        }
+        SDL_free(terminal.paste.data);
+        SDL_zero(terminal.paste);
+        set_terminal_title(NULL);
+    }
+}
+
+/**
+ * Starts streaming the clipboard contents to the terminal child process.
+ * The text is wrapped in bracketed paste markers if the application
+ * enabled DECSET 2004.
+ */
+static void start_terminal_paste(void) {
+    finish_terminal_paste();
+    char *data = SDL_GetClipboardText();
+    if (data == NULL or data[0] == '\0') {
+        SDL_free(data);
+        return;
+    }
+    /* The text must not end the bracketed paste early */
+    size_t marker = sizeof(SDLTERM_PASTE_END) - 1;
+    for (char *found; (found = SDL_strstr(data, SDLTERM_PASTE_END)) != NULL;) {
+        SDL_memmove(found, found + marker, SDL_strlen(found + marker) + 1);
+    }
+    terminal.paste.data = data;
+    terminal.paste.length = SDL_strlen(data);
+    terminal.paste.offset = 0;
+    terminal.paste.ticks = terminal.ticks;
+    vterm_keyboard_start_paste(terminal.vterm);
+}
+
+/**
+ * Returns the number of bytes of pasted text the write queue can take
+ */
+static size_t terminal_paste_space(void) {
+    size_t space = terminal_queue_space();
+    size_t reserve = SDL_min(SDLTERM_PASTE_RESERVE, terminal.queue.capacity / 4);
+    return space > reserve ? space - reserve : 0;
+}
+
+/**
+ * Queues the next chunk of the current paste operation as far as the write
+ * queue has room for it and updates the progress feedback. Some room is
+ * left to keys typed meanwhile and to the end marker of the paste, which is
+ * only queued once it fits.
+ */
+static void update_terminal_paste(void) {
+    static const size_t chunk = 4096;
+    if (terminal.paste.data == NULL) {
+        return;
+    }
+    size_t available = terminal_paste_space();
+    size_t remaining = terminal.paste.length - terminal.paste.offset;
+    size_t length = SDL_min(SDL_min(available, remaining), chunk);
+    if (length > 0 and write_terminal_process(terminal.paste.data + terminal.paste.offset, length)) {
+        terminal.paste.offset += length;
+    }
+    if (terminal.paste.offset == terminal.paste.length) {
+        if (terminal_queue_space() >= sizeof(SDLTERM_PASTE_END) - 1) {
+            finish_terminal_paste();
+        }
+    } else if (terminal.ticks - terminal.paste.ticks > 250) {
+        char status[64];
+        SDL_snprintf(status, sizeof(status), "[pasting %zu%%, Esc to cancel]",
+            terminal.paste.offset * 100 / terminal.paste.length);
+        set_terminal_title(status);
+        terminal.paste.ticks = terminal.ticks;
+    }
+}
+
+/**
+ * Returns SDL_TRUE if the screen row contains the search query
+ */
+static SDL_bool terminal_row_matches(int row) {
+    struct TerminalSearch *search = &terminal.search;
+    size_t length = collect_terminal_text(fetch_terminal_row(row), terminal.cols);
+    return history_find_text(search->text, length, search->query, search->length) != NULL;
+}
+
+/**
+ * Finds the nearest line containing the search query, starting at the given
+ * line and moving up if backward or down otherwise. Lines are numbered over
+ * the scrollback buffer followed by the screen rows. Returns (size_t)-1 if
+ * there is no such line.
+ */
+static size_t find_terminal_match(size_t line, SDL_bool backward) {
+    struct TerminalSearch *search = &terminal.search;
+    size_t length = history_length(terminal.history.lines);
+    size_t total = length + terminal.rows;
+    if (backward) {
+        for (; line != (size_t)-1 and line >= length; line--) {
+            if (line < total and terminal_row_matches(line - length)) {
+                return line;
+            }
+        }
+        if (line == (size_t)-1) {
+            return line;
+        }
+        return history_search(terminal.history.lines, search->query, search->length, line, SDL_TRUE);
+    }
+    if (line < length) {
+        size_t found = history_search(terminal.history.lines, search->query, search->length, line, SDL_FALSE);
+        if (found != (size_t)-1) {
+            return found;
+        }
+        line = length;
+    }
+    for (; line < total; line++) {
+        if (terminal_row_matches(line - length)) {
+            return line;
+        }
+    }
+    return (size_t)-1;
+}
+
+/**
+ * Shows the search query in the window title and renders the view at the
+ * current match with all visible matches highlighted
+ */
+static void show_terminal_search(void) {
+    struct TerminalSearch *search = &terminal.search;
+    char status[sizeof(search->query) + 32];
+    SDL_snprintf(status, sizeof(status), "[search: %s%s]", search->query,
+        search->found or search->length == 0 ? "" : " (not found)");
+    set_terminal_title(status);
+    size_t length = history_length(terminal.history.lines);
+    if (search->found) {
+        /* Matches on the screen are shown at the bottom, matches in the
+         * scrollback buffer in the middle of the window */
+        struct TerminalAnchor *top = &terminal.history.top;
+        top->line = SDL_min(search->line, length);
+        top->row = 0;
+        for (int row = 0; search->line < length and row < terminal.rows / 2; row++) {
+            if (not previous_terminal_row(top)) {
+                break;
+            }
+        }
+        terminal.history.pixels = 0;
+        terminal.dirty = SDL_TRUE;
+    }
+    render_terminal_history();
+}
+
+/**
+ * Moves the current match to the nearest match from the given line on
+ */
+static void find_terminal_search(size_t line, SDL_bool backward) {
+    struct TerminalSearch *search = &terminal.search;
+    size_t found = (size_t)-1;
+    if (search->length > 0 and line != (size_t)-1) {
+        found = find_terminal_match(line, backward);
+    }
+    search->found = found != (size_t)-1;
+    if (search->found) {
+        search->line = found;
+    }
+    show_terminal_search();
+}
+
+/**
+ * Searches the changed query again from the current match on. As long as
+ * it still matches there, the view stays put.
+ */
+static void update_terminal_search(void) {
+    struct TerminalSearch *search = &terminal.search;
+    size_t total = history_length(terminal.history.lines) + terminal.rows;
+    find_terminal_search(SDL_min(search->line, total - 1), SDL_TRUE);
+}
+
+/**
+ * Starts an incremental search from the bottom of the screen upwards
+ */
+static void open_terminal_search(void) {
+    struct TerminalSearch *search = &terminal.search;
+    search->active = SDL_TRUE;
+    search->found = SDL_FALSE;
+    search->length = 0;
+    search->query[0] = '\0';
+    search->line = history_length(terminal.history.lines) + terminal.rows - 1;
+    show_terminal_search();
+}
+
+/**
+ * Ends the search, leaving the view where the last match was
+ */
+static void close_terminal_search(void) {
+    terminal.search.active = SDL_FALSE;
+    set_terminal_title(NULL);
+    render_terminal_history();
+}
+
+/**
+ * Appends text typed while searching to the query
+ */
+static void append_terminal_search(const char *text) {
+    struct TerminalSearch *search = &terminal.search;
+    size_t length = SDL_strlen(text);
+    if (search->length + length < sizeof(search->query)) {
+        SDL_memcpy(search->query + search->length, text, length + 1);
+        search->length += length;
+        update_terminal_search();
+    }
+}
+
+/**
+ * Handles keys while searching: Return or Up jumps to the previous (older)
+ * match, Shift-Return or Down to the next one, Backspace edits the query
+ * and Escape ends the search. Other keys are swallowed.
+ */
+static void handle_search_key(SDL_Keycode sym, SDL_bool shift_pressed) {
+    struct TerminalSearch *search = &terminal.search;
+    switch (sym) {
+        default:
+            break;
+        case SDLK_ESCAPE:
+            close_terminal_search();
+            break;
+        case SDLK_RETURN:
+        case SDLK_KP_ENTER:
+            find_terminal_search(shift_pressed ? search->line + 1 : search->line - 1, not shift_pressed);
+            break;
+        case SDLK_UP:
+            find_terminal_search(search->line - 1, SDL_TRUE);
+            break;
+        case SDLK_DOWN:
+            find_terminal_search(search->line + 1, SDL_FALSE);
+            break;
+        case SDLK_BACKSPACE:
+            /* Remove the last character including its continuation bytes */
+            while (search->length > 0 and (search->query[--search->length] & 0xc0) == 0x80);
+            search->query[search->length] = '\0';
+            update_terminal_search();
+            break;
+    }
+}
+
+/**
+ * Starts writing the scrollback buffer and the screen to the export file in
+ * the background. The screen is copied right away, the scrollback buffer is
+ * read from a snapshot while new lines keep being pushed.
+ */
+static void start_terminal_export(void) {
+    const char *path = configuration.export.path ? configuration.export.path : "sdlterm-history.txt";
+    if (terminal.export.job != NULL) {
+        SDL_Log("Export to %s still in progress", path);
+        return;
+    }
+    struct HistorySnapshot *snapshot = history_snapshot(terminal.history.lines);
+    if (snapshot == NULL) {
+        return;
+    }
+    VTermScreenCell blank = blank_terminal_cell();
+    struct Export *job = export_create(path, configuration.export.format, &blank);
+    if (job == NULL) {
+        history_snapshot_free(snapshot);
+        return;
+    }
+    for (int row = 0; row < terminal.rows; row++) {
+        SDL_bool continuation = vterm_state_get_lineinfo(terminal.state, row)->continuation;
+        export_add_row(job, fetch_terminal_row(row), terminal.cols, continuation);
+    }
+    SDL_Log("Exporting scrollback to %s", path);
+    terminal.export.job = job;
+    export_start(job, snapshot, terminal.watcher.event);
+}
+
+/**
+ * Collects the export once it is done
+ */
+static void finish_terminal_export(void) {
+    size_t lines;
+    if (export_finish(terminal.export.job, &lines)) {
+        SDL_Log("Exported %zu lines of scrollback", lines);
+    } else {
+        SDL_Log("Failed to write scrollback export");
+    }
+    terminal.export.job = NULL;
+}
+
+/**
+ * Merges a rectangle into the damage pending for the next frame
+ */
+static void damage_terminal_rect(VTermRect rect) {
+    if (terminal.batch.flush) {
+        VTermRect *batch = &terminal.batch.rect;
+        batch->start_row = SDL_min(batch->start_row, rect.start_row);
+        batch->start_col = SDL_min(batch->start_col, rect.start_col);
+        batch->end_row = SDL_max(batch->end_row, rect.end_row);
+        batch->end_col = SDL_max(batch->end_col, rect.end_col);
+    } else {
+        terminal.batch.rect = rect;
+        terminal.batch.flush = SDL_TRUE;
+    }
+}
+
+/**
+ * Renders the damage accumulated since the last frame and the cursor on top
+ */
+static void render_terminal_damage(void) {
+    VTermRect *rect = &terminal.batch.rect;
+    terminal.batch.flush = SDL_FALSE;
+    rect->end_row = SDL_min(rect->end_row, terminal.rows);
+    rect->end_col = SDL_min(rect->end_col, terminal.cols);
+    render_terminal_rect(rect);
+    if (
+        terminal.cursor.visible and
+        terminal.cursor.cell.y >= rect->start_row and terminal.cursor.cell.y < rect->end_row and
+        terminal.cursor.cell.x >= rect->start_col and terminal.cursor.cell.x < rect->end_col
+    ) {
+        render_terminal_cursor(SDL_TRUE);
+    }
+}
+
+/**
+ * Returns SDL_TRUE once the frame interval of the frame-rate cap elapsed
+ */
+static SDL_bool terminal_frame_due(void) {
+    return SDL_TICKS_PASSED(SDL_GetTicks(), terminal.frame.ticks + terminal.frame.interval);
+}
+
+/**
+ * Returns SDL_TRUE if more output arrived during the current frame than the
+ * jump-scroll threshold, in which case only the final state gets rendered.
+ */
+static SDL_bool terminal_flooded(void) {
+    return configuration.process.jumpscroll > 0 and terminal.frame.bytes > configuration.process.jumpscroll;
+}
+
+/**
+ * Returns SDL_TRUE while the application holds back presentation with a
+ * synchronized update (DEC private mode 2026). The update is given up on
+ * once it takes longer than the configured timeout.
+ */
+static SDL_bool terminal_synchronized(void) {
+    if (terminal.sync.active and SDL_TICKS_PASSED(SDL_GetTicks(), terminal.sync.ticks + configuration.process.synctimeout)) {
+        SDL_LogDebug(0, "Synchronized update timed out");
+        terminal.sync.active = SDL_FALSE;
+    }
+    return terminal.sync.active;
+}
+
+/******************************************************************************
+ * Terminal Emulator Scheduling
+ *****************************************************************************/
+
+/**
+ * Returns SDL_TRUE if heap entry a is due before heap entry b
+ */
+static SDL_bool deadline_before(int a, int b) {
+    return (Sint32)(terminal.scheduler.heap[a].ticks - terminal.scheduler.heap[b].ticks) < 0;
+}
+
+static void swap_deadlines(int a, int b) {
+    struct TerminalScheduler *scheduler = &terminal.scheduler;
+    struct TerminalDeadline deadline = scheduler->heap[a];
+    scheduler->heap[a] = scheduler->heap[b];
+    scheduler->heap[b] = deadline;
+    scheduler->position[scheduler->heap[a].timer] = a + 1;
+    scheduler->position[scheduler->heap[b].timer] = b + 1;
+}
+
+/**
+ * Restores the min-heap order after the entry at index changed
+ */
+static void sift_deadline(int index) {
+    struct TerminalScheduler *scheduler = &terminal.scheduler;
+    while (index > 0 and deadline_before(index, (index - 1) / 2)) {
+        swap_deadlines(index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+    for (;;) {
+        int child = index * 2 + 1;
+        if (child >= scheduler->length) {
+            break;
+        }
+        if (child + 1 < scheduler->length and deadline_before(child + 1, child)) {
+            child++;
+        }
+        if (not deadline_before(child, index)) {
+            break;
+        }
+        swap_deadlines(index, child);
+        index = child;
+    }
+}
+
+/**
+ * Schedules a timer to expire at the given ticks, replacing its previous
+ * deadline if it was already scheduled
+ */
+static void schedule_timer(enum TerminalTimer timer, Uint32 ticks) {
+    struct TerminalScheduler *scheduler = &terminal.scheduler;
+    int index = scheduler->position[timer] - 1;
+    if (index < 0) {
+        index = scheduler->length++;
+        scheduler->heap[index].timer = timer;
+        scheduler->position[timer] = index + 1;
+    }
+    scheduler->heap[index].ticks = ticks;
+    sift_deadline(index);
+}
+
+/**
+ * Removes a timer from the schedule
+ */
+static void cancel_timer(enum TerminalTimer timer) {
+    struct TerminalScheduler *scheduler = &terminal.scheduler;
+    int index = scheduler->position[timer] - 1;
+    if (index >= 0) {
+        int last = --scheduler->length;
+        if (index != last) {
+            swap_deadlines(index, last);
+        }
+        scheduler->position[timer] = 0;
+        if (index != last) {
+            sift_deadline(index);
+        }
+    }
+}
+
+/**
+ * Removes and returns the earliest timer that expired by the given ticks or
+ * -1 if there is none
+ */
+static int expire_timer(Uint32 ticks) {
+    struct TerminalScheduler *scheduler = &terminal.scheduler;
+    if (scheduler->length == 0 or not SDL_TICKS_PASSED(ticks, scheduler->heap[0].ticks)) {
+        return -1;
+    }
+    int timer = scheduler->heap[0].timer;
+    cancel_timer(timer);
+    return timer;
+}
+
+/**
+ * Returns the milliseconds until the earliest deadline or -1 if nothing is
+ * scheduled
+ */
+static int next_timer_timeout(void) {
+    struct TerminalScheduler *scheduler = &terminal.scheduler;
+    if (scheduler->length == 0) {
+        return -1;
+    }
+    Sint32 timeout = scheduler->heap[0].ticks - SDL_GetTicks();
+    return SDL_max(timeout, 0);
+}
+
+/**
+ * Returns SDL_TRUE once the terminal child process exited. The exit is
+ * noticed through its pidfd by the watcher thread (or here if there is no
+ * watcher) or through SIGCHLD on kernels without pidfd_open.
+ */
+static SDL_bool terminal_process_exited(void) {
+    if (not terminal.process.exited and terminal.process.pidfd >= 0 and terminal.watcher.thread == NULL) {
+        struct pollfd pollfd = { .fd = terminal.process.pidfd, .events = POLLIN };
+        terminal.process.exited = poll(&pollfd, 1, 0) > 0;
+    }
+    return terminal.process.exited;
+}
+
+/**
+ * Waits for the terminal child process to become readable (or writable,
+ * as requested by the event loop) and wakes up the event loop with an SDL
+ * event. The loop re-arms the watcher before it goes back to sleep.
+ */
+static int watch_terminal_process(void *data) {
+    for (;;) {
+        SDL_SemWait(terminal.watcher.arm);
+        for (;;) {
+            if (SDL_AtomicGet(&terminal.watcher.quit)) {
+                return 0;
+            }
+            struct pollfd fds[3] = {
+                { .fd = terminal.process.fd, .events = SDL_AtomicGet(&terminal.watcher.events) },
+                { .fd = terminal.watcher.wakefd, .events = POLLIN },
+                { .fd = terminal.process.exited ? -1 : terminal.process.pidfd, .events = POLLIN }
+            };
+            if (terminal.process.uring != NULL) {
+                fds[0].fd = uring_fd(terminal.process.uring);
+            }
+            if (poll(fds, 3, -1) < 0) {
+                continue;
+            }
+            if (fds[2].revents) {
+                terminal.process.exited = 1;
+            }
+            if (fds[1].revents) {
+                /* Woken up to re-read the requested events or by a signal */
+                eventfd_t value;
+                eventfd_read(terminal.watcher.wakefd, &value);
+                if (not terminal.watcher.signalled) {
+                    continue;
+                }
+                terminal.watcher.signalled = 0;
+            }
+            break;
+        }
+        SDL_AtomicSet(&terminal.watcher.armed, 0);
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = terminal.watcher.event;
+        SDL_PushEvent(&event);
+    }
+}
+
+/**
+ * Arms the watcher thread before the event loop goes to sleep
+ */
+static void arm_terminal_watcher(void) {
+    int events = POLLIN;
+    if (terminal.process.uring == NULL and terminal.queue.length > 0) {
+        events |= POLLOUT;
+    }
+    int previous = SDL_AtomicSet(&terminal.watcher.events, events);
+    if (SDL_AtomicCAS(&terminal.watcher.armed, 0, 1)) {
+        SDL_SemPost(terminal.watcher.arm);
+    } else if (previous != events) {
+        eventfd_write(terminal.watcher.wakefd, 1);
+    }
+}
+
+/******************************************************************************
+ * Terminal Emulator Statistics
+ *****************************************************************************/
+
+/**
+ * Records the time between two performance counter values in a latency
+ * histogram. Bucket 0 counts latencies below 1 ms, bucket n counts
+ * latencies from 2^(n-1) ms up to 2^n ms and the last bucket everything
+ * above.
+ */
+static void record_latency(struct LatencyHistogram *histogram, Uint64 start, Uint64 end) {
+    double ms = (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    int bucket = 0;
+    for (double limit = 1.0; ms >= limit and bucket < SDL_arraysize(histogram->buckets) - 1; limit *= 2) {
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+    histogram->samples++;
+    histogram->total += ms;
+    histogram->max = SDL_max(histogram->max, ms);
+}
 
-    flood_cell(position, bgcolor);
-    SDL_Point coordinates = { map_to_x(position.col), map_to_y(position.row) };
-    SDL_SetRenderDrawColor(terminal.renderer, fgcolor.r, fgcolor.g, fgcolor.b, 255);
-    FOX_DrawGlyph(font, &coordinates, character);
-    terminal.dirty = SDL_TRUE;
+/**
+ * Stamps keyboard input so the latency until it shows up on screen can be
+ * measured. Only the first input since the last present is tracked.
+ */
+static void stamp_terminal_input(void) {
+    if (terminal.latency.input == 0) {
+        terminal.latency.input = SDL_GetPerformanceCounter();
+        terminal.latency.echoed = SDL_FALSE;
+    }
 }
 
 /**
- * Renders the whole screen of current vterm cells
+ * Queues keyboard input for the terminal child process, stamping it once it
+ * is actually queued
  */
-static void render_terminal_rect(VTermRect *rect) {
-    VTermPos position;
-    for (position.row = rect->start_row; position.row < rect->end_row; position.row++) {
-		for (position.col = rect->start_col; position.col < rect->end_col; position.col++) {
-            VTermScreenCell cell;
-            vterm_screen_get_cell(terminal.screen, position, &cell);
-			render_terminal_cell(&cell, position);
-		}
-	}
+static void send_terminal_input(const char *data, size_t length) {
+    if (write_terminal_process(data, length)) {
+        stamp_terminal_input();
+    }
 }
 
 /**
- * Renders the whole screen of current vterm cells
+ * Matches stamped input to the first read from the terminal child process
  */
-static void render_terminal_screen(void) {
-    VTermRect rect = {
-        .start_col = 0,
-        .start_row = 0,
-        .end_col = terminal.cols,
-        .end_row = terminal.rows
-    };
-    render_terminal_rect(&rect);
+static void stamp_terminal_read(void) {
+    if (terminal.latency.input != 0 and not terminal.latency.echoed) {
+        record_latency(&terminal.latency.echo, terminal.latency.input, SDL_GetPerformanceCounter());
+        terminal.latency.echoed = SDL_TRUE;
+    }
 }
 
 /**
- * Renders the scrollback buffer according to the history offset
+ * Matches echoed input to the screen refresh that shows it
  */
-static void render_terminal_history(void) {
-    VTermPos pos;
-    size_t index = terminal.history.length - terminal.history.offset;
-	for (pos.row = 0; pos.row < terminal.rows; pos.row++) {
-        if (index == terminal.history.length) {
-            break;
-        }
-        struct TerminalHistoryItem *item = &terminal.history.elements[index++];
-		for (pos.col = 0; pos.col < item->length; pos.col++) {
-			VTermScreenCell *cell = &item->line[pos.col];
-            render_terminal_cell(cell, pos);
-		}
-	}
-	for (int offset = pos.row; pos.row < terminal.rows; pos.row++) {
-		for (pos.col = 0; pos.col < terminal.cols; pos.col++) {
-			VTermScreenCell cell;
-            VTermPos cellpos = {.col = pos.col, .row = pos.row - offset};
-			vterm_screen_get_cell(terminal.screen, cellpos, &cell);
-			render_terminal_cell(&cell, pos);
-		}
-	}
+static void stamp_terminal_present(void) {
+    if (terminal.latency.input != 0 and terminal.latency.echoed) {
+        record_latency(&terminal.latency.present, terminal.latency.input, SDL_GetPerformanceCounter());
+        terminal.latency.input = 0;
+    }
 }
 
 /**
- * Renders the terminal cell cursor
+ * Counts a present and the frame intervals it missed since it became due,
+ * be it because of slow rendering or a missed vertical blank
  */
-static void render_terminal_cursor(SDL_bool enabled) {
-    VTermPos position = {
-        .col = terminal.cursor.cell.x,
-        .row = terminal.cursor.cell.y
-    };
-    VTermScreenCell cell;
-    vterm_screen_get_cell(terminal.screen, position, &cell);
-    if (enabled) {
-        static const SDL_Color color = {255, 255, 255, 255};
-        flood_cell(position, color);
-    } else {
-        render_terminal_cell(&cell, position);
+static void count_terminal_present(void) {
+    struct TerminalPresent *present = &terminal.present;
+    Uint32 now = SDL_GetTicks();
+    if (terminal.frame.interval > 0) {
+        present->dropped += (now - present->due) / terminal.frame.interval;
     }
+    present->frames++;
+    present->ticks = now;
+    present->pending = SDL_FALSE;
 }
 
 /**
- * Highlights cells in their reverse color or reverts them back to normal
+ * Prints the collected statistics to stderr
  */
-static void highlight_cells(VTermRect rect, SDL_bool highlight) {
-    VTermPos pos;
-    for (pos.row = rect.start_row; pos.row < rect.end_row+1; pos.row++) {
-        for (pos.col = rect.start_col; pos.col <= rect.end_col; pos.col++) {
-            VTermScreenCell cell;
-            vterm_screen_get_cell(terminal.screen, pos, &cell);
-            if (highlight) {
-			    cell.attrs.reverse = !cell.attrs.reverse;
-            }
-			render_terminal_cell(&cell, pos);
+static void print_terminal_statistics(void) {
+    struct LatencyHistogram *echo = &terminal.latency.echo;
+    struct LatencyHistogram *present = &terminal.latency.present;
+    fputs("sdlterm statistics\n", stderr);
+    fprintf(stderr, "  %-14s %12s %12s\n", "latency (ms)", "input-read", "input-frame");
+    for (int i = 0; i < SDL_arraysize(echo->buckets); i++) {
+        char range[32];
+        if (i == 0) {
+            SDL_snprintf(range, sizeof(range), "< 1");
+        } else if (i == SDL_arraysize(echo->buckets) - 1) {
+            SDL_snprintf(range, sizeof(range), ">= %d", 1 << (i - 1));
+        } else {
+            SDL_snprintf(range, sizeof(range), "%d - %d", 1 << (i - 1), 1 << i);
         }
+        fprintf(stderr, "  %-14s %12u %12u\n", range, echo->buckets[i], present->buckets[i]);
     }
+    fprintf(stderr, "  %-14s %12u %12u\n", "samples", echo->samples, present->samples);
+    fprintf(stderr, "  %-14s %12.2f %12.2f\n", "mean",
+        echo->samples ? echo->total / echo->samples : 0.0,
+        present->samples ? present->total / present->samples : 0.0);
+    fprintf(stderr, "  %-14s %12.2f %12.2f\n", "max", echo->max, present->max);
+    Uint32 elapsed = SDL_GetTicks() - terminal.present.start;
+    fprintf(stderr, "  %-14s %12u\n", "frames", terminal.present.frames);
+    fprintf(stderr, "  %-14s %12u\n", "dropped", terminal.present.dropped);
+    fprintf(stderr, "  %-14s %12.2f\n", "frames/s",
+        elapsed ? terminal.present.frames * 1000.0 / elapsed : 0.0);
+    struct HistoryStatistics history;
+    history_statistics(terminal.history.lines, &history);
+    size_t overhead = history.allocated + history.index - history.encoded;
+    fprintf(stderr, "  %-14s %12zu\n", "history lines", history.lines);
+    fprintf(stderr, "  %-14s %12zu\n", "history slabs", history.slabs);
+    fprintf(stderr, "  %-14s %12zu\n", "history spilled", history.spilled);
+    fprintf(stderr, "  %-14s %12zu\n", "history disk KiB", history.stored / 1024);
+    fprintf(stderr, "  %-14s %12zu\n", "history packed", history.compressed);
+    fprintf(stderr, "  %-14s %12.2f\n", "compression",
+        history.packed ? (double)history.unpacked / history.packed : 0.0);
+    fprintf(stderr, "  %-14s %12zu\n", "history KiB", history.encoded / 1024);
+    fprintf(stderr, "  %-14s %12zu\n", "overhead KiB", overhead / 1024);
+    fprintf(stderr, "  %-14s %12.2f\n", "overhead %",
+        history.encoded ? overhead * 100.0 / history.encoded : 0.0);
 }
 
 /******************************************************************************
  * Terminal Emulator VTerm Callbacks
  *****************************************************************************/
 
+/**
+ * Queues output of libvterm, mostly replies to queries of the application.
+ * Unlike key input it is never dropped, the queue grows to take it.
+ */
+static void terminal_output(const char *s, size_t len, void *userdata) {
+    if (len > terminal_queue_space()) {
+        grow_terminal_queue(len);
+    }
+    write_terminal_process(s, len);
+}
+
 static int terminal_damage(VTermRect rect, void *userdata) {
-    render_terminal_rect(&rect);
+    damage_terminal_rect(rect);
     return 0;
 }
 
 static int terminal_moverect(VTermRect dest, VTermRect src, void *userdata) {
-    terminal.batch.rect = dest;
-    terminal.batch.flush = SDL_TRUE;
+    damage_terminal_rect(dest);
     return 0;
 }
 
 static int terminal_movecursor(VTermPos pos, VTermPos oldpos, int visible, void *userdata) {
-    render_terminal_cursor(SDL_FALSE); /* redraw old cell before moving */
+    VTermRect oldrect = {
+        .start_row = oldpos.row, .end_row = oldpos.row + 1,
+        .start_col = oldpos.col, .end_col = oldpos.col + 1
+    };
+    VTermRect newrect = {
+        .start_row = pos.row, .end_row = pos.row + 1,
+        .start_col = pos.col, .end_col = pos.col + 1
+    };
+    damage_terminal_rect(oldrect); /* redraw old cell before moving */
+    damage_terminal_rect(newrect);
     terminal.cursor.cell.x = pos.col;
     terminal.cursor.cell.y = pos.row;
-    terminal.cursor.ticks = terminal.ticks;
     terminal.cursor.visible = SDL_TRUE;
-    render_terminal_cursor(terminal.cursor.visible);
+    if (configuration.cursor.interval > 0 and not terminal.hidden) {
+        schedule_timer(TIMER_CURSOR, terminal.ticks + configuration.cursor.interval);
+    }
     return 0;
 }
 
 static int terminal_settermprop(VTermProp prop, VTermValue *val, void *userdata) {
-    return 0;
+    switch (prop) {
+        default:
+            break;
+        case VTERM_PROP_SYNCUPDATE:
+            terminal.sync.active = val->boolean;
+            terminal.sync.ticks = SDL_GetTicks();
+            if (terminal.sync.active) {
+                schedule_timer(TIMER_SYNC, terminal.sync.ticks + configuration.process.synctimeout);
+            } else {
+                cancel_timer(TIMER_SYNC);
+            }
+            break;
+    }
+    /* Accept the property, so that libvterm stores it and reports it when
+     * queried with DECRQM */
+    return 1;
 }
 
 static int terminal_bell(void *userdata) {
-    terminal.bell.ticks = terminal.ticks;
+    terminal.dirty = SDL_TRUE;
     terminal.bell.active = SDL_TRUE;
+    schedule_timer(TIMER_BELL, terminal.ticks + 150);
     return 0;
 }
 
-static int terminal_sb_pushline(int cols, const VTermScreenCell *cells, void *userdata) {
+/**
+ * Keeps a selection point on its cell while a screen row is pushed into the
+ * scrollback buffer, appended to the newest line or as a new line which may
+ * evict the oldest one
+ */
+static void follow_terminal_push(struct TerminalPoint *point, size_t length, SDL_bool appended, SDL_bool evicted) {
+    if (appended and point->line == length) {
+        /* The top screen row became the last row of the newest line */
+        const struct HistoryLine *line = history_get(terminal.history.lines, length - 1);
+        point->line = length - 1;
+        point->cell += history_line_wrap(line, terminal.cols, history_line_rows(line, terminal.cols) - 1);
+    } else if (appended and point->line > length) {
+        point->line--;
+    } else if (evicted and point->line > 0) {
+        point->line--;
+    } else if (evicted) {
+        point->cell = 0;
+    }
+}
+
+static int terminal_sb_pushline4(
+    int cols, const VTermScreenCell *cells, bool continuation, void *userdata
+) {
     if (not configuration.history.enable) {
         return 0;
     }
-    if (terminal.history.length == terminal.history.size) {
-        terminal.history.size += 100;
-        terminal.history.size *= 2;
-        size_t size = terminal.history.size * sizeof(*terminal.history.elements);
-        terminal.history.elements = SDL_realloc(terminal.history.elements, size);
+    struct TerminalHistory *history = &terminal.history;
+    SDL_bool scrolled_back = terminal_scrolled_back();
+    size_t length = history_length(history->lines);
+    VTermScreenCell blank = blank_terminal_cell();
+    SDL_bool appended = history_push(history->lines, cells, cols, &blank, continuation);
+    SDL_bool evicted = not appended and history_length(history->lines) == length;
+    history->decoded = (size_t)-1;
+    if (evicted and terminal.search.line > 0) {
+        /* The oldest line was evicted, the others moved up by one */
+        terminal.search.line--;
+    }
+    if (terminal.mouse.lmb) {
+        follow_terminal_push(&terminal.mouse.start, length, appended, evicted);
+        follow_terminal_push(&terminal.mouse.end, length, appended, evicted);
+    }
+    if (not scrolled_back) {
+        history->top.line = history_length(history->lines);
+        return 0;
+    }
+    /* A scrolled back view stays on the rows it shows. The top screen row
+     * just became the newest line or the last row of it. */
+    if (history->top.line == length and appended) {
+        history->top.line = length - 1;
+        history->top.row = terminal_line_rows(length - 1) - 1;
+    } else if (evicted and history->top.line > 0) {
+        history->top.line--;
+    } else if (evicted) {
+        history->top.row = 0;
     }
-    struct TerminalHistoryItem *item = &terminal.history.elements[terminal.history.length++];
-    item->line = SDL_malloc(sizeof(*item->line) * cols);
-    SDL_memcpy(item->line, cells, sizeof(*cells) * cols);
-    item->length = cols;
+    history->above.line = (size_t)-1;
     return 0;
 }
 
-static int terminal_sb_popline(int cols, VTermScreenCell *cells, void *userdata) {
-    return 0;
+/**
+ * Hands the last row of the scrollback buffer back to the screen when it
+ * grows taller, wrapped at the narrower of the old and the new width
+ */
+static int terminal_sb_popline4(int cols, VTermScreenCell *cells, bool *continuation, void *userdata) {
+    struct TerminalHistory *history = &terminal.history;
+    VTermScreenCell blank = blank_terminal_cell();
+    int width = SDL_min(cols, terminal.cols);
+    SDL_bool wrapped;
+    if (not history_pop(history->lines, cells, width, &blank, &wrapped)) {
+        return 0;
+    }
+    for (int col = width; col < cols; col++) {
+        cells[col] = blank;
+    }
+    *continuation = wrapped;
+    history->decoded = (size_t)-1;
+    history->above.line = (size_t)-1;
+    size_t length = history_length(history->lines);
+    if (history->top.line >= length) {
+        history->top.line = length;
+        history->top.row = 0;
+    }
+    return 1;
 }
 
 static int terminal_sb_clear(void *userdata) {
@@ -710,9 +2298,18 @@ static void signal_handler(int signum) {
 		default:
 			break;
 		case SIGCHLD:
-			terminal.process.running = SDL_FALSE;
+			terminal.process.exited = 1;
+			break;
+		case SIGUSR1:
+			terminal.statistics = 1;
+			break;
+		case SIGUSR2:
+			terminal.export.requested = 1;
 			break;
 	}
+	/* Wake up the event loop */
+	terminal.watcher.signalled = 1;
+	eventfd_write(terminal.watcher.wakefd, 1);
 }
 
 /**
@@ -792,6 +2389,9 @@ static void open_terminal_emulator(void) {
 
     /* Configure terminal renderer */
     Uint32 renderer_flags = SDL_RENDERER_TARGETTEXTURE;
+    if (configuration.window.vsync) {
+        renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
     terminal.renderer = SDL_CreateRenderer(
         terminal.window, configuration.window.renderer_index, renderer_flags
     );
@@ -799,7 +2399,25 @@ static void open_terminal_emulator(void) {
         fputs(SDL_GetError(), stderr);
         exit(EXIT_FAILURE);
     }
-    clear_terminal_window();
+
+    /* Configure frame pacing; with vsync the frame interval follows the
+     * display refresh rate unless the fps cap is lower */
+    SDL_RendererInfo renderer_info;
+    SDL_DisplayMode display_mode;
+    if (configuration.window.fps > 0) {
+        terminal.frame.interval = 1000 / configuration.window.fps;
+    }
+    if (
+        SDL_GetRendererInfo(terminal.renderer, &renderer_info) == 0 and
+        renderer_info.flags & SDL_RENDERER_PRESENTVSYNC and
+        SDL_GetWindowDisplayMode(terminal.window, &display_mode) == 0 and
+        display_mode.refresh_rate > 0
+    ) {
+        terminal.frame.interval = SDL_max(terminal.frame.interval, 1000 / display_mode.refresh_rate);
+    } else if (configuration.window.vsync) {
+        SDL_Log("Vsync unavailable, presenting at the fps cap");
+    }
+    terminal.present.start = SDL_GetTicks();
 
     /* Load and configure fonts */
     terminal.font.regular = FOX_OpenFont(
@@ -826,6 +2444,18 @@ static void open_terminal_emulator(void) {
     terminal.cols = map_to_col(terminal.width);
     terminal.fullscreen = configuration.window.flags & SDL_WINDOW_FULLSCREEN;
     terminal.cursor.visible = SDL_TRUE;
+    resize_terminal_texture();
+    resize_terminal_cache();
+    if (configuration.process.synctimeout == 0) {
+        configuration.process.synctimeout = 150;
+    }
+
+    /* Configure scrollback buffer */
+    terminal.history.lines = history_create(
+        configuration.history.infinite ? 0 : configuration.history.limit
+    );
+    terminal.history.above.line = (size_t)-1;
+    terminal.history.decoded = (size_t)-1;
 
     /* Configure virtual terminal */
     static const VTermScreenCallbacks callbacks = {
@@ -834,9 +2464,9 @@ static void open_terminal_emulator(void) {
 		.movecursor  = terminal_movecursor,
 		.settermprop = terminal_settermprop,
 		.bell        = terminal_bell,
-		.sb_pushline = terminal_sb_pushline,
-		.sb_popline  = terminal_sb_popline,
-		.sb_clear    = terminal_sb_clear
+		.sb_clear    = terminal_sb_clear,
+		.sb_pushline4 = terminal_sb_pushline4,
+		.sb_popline4  = terminal_sb_popline4
     };
     terminal.vterm = vterm_new(terminal.rows, terminal.cols);
     terminal.state = vterm_obtain_state(terminal.vterm);
@@ -845,8 +2475,13 @@ static void open_terminal_emulator(void) {
     vterm_screen_enable_reflow(terminal.screen, true);
     vterm_set_utf8(terminal.vterm, 1);
     vterm_screen_set_callbacks(terminal.screen, &callbacks, NULL);
+    vterm_screen_callbacks_has_pushline4(terminal.screen);
+    vterm_output_set_callback(terminal.vterm, terminal_output, NULL);
     vterm_screen_reset(terminal.screen, 1);
 
+    /* Wake-up descriptor of the watcher thread, also used by signals */
+    terminal.watcher.wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
     /* Launch and configure terminal child process */
     struct winsize winsize = {
 		.ws_col = terminal.cols,
@@ -868,17 +2503,47 @@ static void open_terminal_emulator(void) {
 		action.sa_handler = signal_handler;
 		action.sa_flags = 0;
 		sigemptyset(&action.sa_mask);
-		sigaction(SIGCHLD, &action, NULL);
+		sigaction(SIGUSR1, &action, NULL);
+		sigaction(SIGUSR2, &action, NULL);
+
+		/* Supervise the child through a pidfd polled along with the pty,
+		 * SIGCHLD is only a fallback as it interrupts reads and waits */
+		terminal.process.pidfd = syscall(SYS_pidfd_open, terminal.process.pid, 0);
+		if (terminal.process.pidfd < 0) {
+			SDL_LogDebug(0, "pidfd_open unavailable, using SIGCHLD");
+			sigaction(SIGCHLD, &action, NULL);
+		}
 
+		/* io_uring needs a blocking fd to wait for data in the kernel */
 		int flags = fcntl(terminal.process.fd, F_GETFL, 0);
-		fcntl(terminal.process.fd, F_SETFL, flags | O_NONBLOCK);
+		if (configuration.process.uring) {
+			fcntl(terminal.process.fd, F_SETFL, flags & ~O_NONBLOCK);
+			terminal.process.uring = uring_open(terminal.process.fd, 65536);
+			if (terminal.process.uring == NULL) {
+				SDL_Log("io_uring unavailable, using read: %s", SDL_GetError());
+			}
+		}
+		if (terminal.process.uring == NULL) {
+			fcntl(terminal.process.fd, F_SETFL, flags | O_NONBLOCK);
+		}
 
 		terminal.process.running = SDL_TRUE;
-		char title[256] = {0};
-		SDL_strlcat(title, configuration.window.title, sizeof(title));
-		SDL_strlcat(title, ": ", sizeof(title));
-		SDL_strlcat(title, configuration.process.cmdline, sizeof(title));
-		SDL_SetWindowTitle(terminal.window, title);
+		set_terminal_title(NULL);
+    }
+
+    /* Configure terminal child process write queue */
+    terminal.queue.capacity = configuration.process.queue;
+    if (terminal.queue.capacity == 0) {
+        terminal.queue.capacity = 65536;
+    }
+    terminal.queue.buffer = SDL_malloc(terminal.queue.capacity);
+
+    /* Configure terminal child process watcher */
+    terminal.watcher.event = SDL_RegisterEvents(1);
+    terminal.watcher.arm = SDL_CreateSemaphore(0);
+    terminal.watcher.thread = SDL_CreateThread(watch_terminal_process, "watcher", NULL);
+    if (terminal.watcher.thread == NULL) {
+        SDL_Log("Failed to create watcher thread, polling instead: %s", SDL_GetError());
     }
 
     /* Configure input devices */
@@ -891,6 +2556,16 @@ static void open_terminal_emulator(void) {
  *****************************************************************************/
 
 static void close_terminal_emulator(void) {
+    if (terminal.watcher.thread != NULL) {
+        SDL_AtomicSet(&terminal.watcher.quit, 1);
+        SDL_SemPost(terminal.watcher.arm);
+        eventfd_write(terminal.watcher.wakefd, 1);
+        SDL_WaitThread(terminal.watcher.thread, NULL);
+    }
+    SDL_DestroySemaphore(terminal.watcher.arm);
+    if (terminal.process.pidfd >= 0) {
+        close(terminal.process.pidfd);
+    }
     if (terminal.process.running) {
 		int wstatus;
 		kill(terminal.process.pid, SIGKILL);
@@ -900,16 +2575,29 @@ static void close_terminal_emulator(void) {
 		} while(!WIFEXITED(wstatus) && !WIFSIGNALED(wstatus));
 		SDL_LogDebug(0, "Child process terminated");
 	}
+    if (terminal.process.uring != NULL) {
+        uring_close(terminal.process.uring);
+    }
+    close(terminal.watcher.wakefd);
     SDL_StopTextInput();
-    for (size_t i = 0; i < terminal.history.length; i++) {
-        SDL_free(terminal.history.elements[i].line);
+    SDL_free(terminal.paste.data);
+    SDL_free(terminal.queue.buffer);
+    SDL_free(terminal.queue.retired);
+    if (terminal.export.job != NULL) {
+        finish_terminal_export();
     }
-    SDL_free(terminal.history.elements);
+    history_destroy(terminal.history.lines);
+    SDL_free(terminal.history.row);
+    SDL_free(terminal.history.cells);
+    SDL_free(terminal.search.text);
+    SDL_free(terminal.search.columns);
+    SDL_free(terminal.cache.cells);
     vterm_free(terminal.vterm);
     FOX_CloseFont(terminal.font.bold);
     FOX_CloseFont(terminal.font.regular);
     FOX_CloseFont(terminal.font.underline);
     SDL_FreeCursor(terminal.pointer);
+    SDL_DestroyTexture(terminal.texture);
     SDL_DestroyRenderer(terminal.renderer);
     SDL_DestroyWindow(terminal.window);
     IMG_Quit();
@@ -937,13 +2625,43 @@ static void handle_window_event(SDL_WindowEvent *event) {
             terminal.y = event->data2;
             break;
 
-        case SDL_WINDOWEVENT_SIZE_CHANGED:
+        case SDL_WINDOWEVENT_SIZE_CHANGED: {
+            /* Resizes are applied live, throttled to the frame rate */
+            Uint32 due = terminal.ticks_resize + terminal.frame.interval;
             SDL_LogDebug(0, "event.window.resize(%d, %d)", event->data1, event->data2);
             terminal.width = event->data1;
             terminal.height = event->data2;
-            terminal.cols = map_to_col(terminal.width);
-            terminal.rows = map_to_row(terminal.height);
-            terminal.ticks_resize = terminal.ticks;
+            schedule_timer(TIMER_RESIZE, SDL_TICKS_PASSED(terminal.ticks, due) ? terminal.ticks : due);
+            break;
+        }
+
+        case SDL_WINDOWEVENT_HIDDEN:
+        case SDL_WINDOWEVENT_MINIMIZED:
+            /* Output is still parsed, but damage only accumulates until the
+             * window becomes visible again */
+            SDL_LogDebug(0, "event.window.hidden()");
+            terminal.hidden = SDL_TRUE;
+            cancel_timer(TIMER_CURSOR);
+            break;
+
+        case SDL_WINDOWEVENT_SHOWN:
+        case SDL_WINDOWEVENT_RESTORED:
+        case SDL_WINDOWEVENT_EXPOSED:
+            if (terminal.hidden) {
+                SDL_LogDebug(0, "event.window.shown()");
+                terminal.hidden = SDL_FALSE;
+                terminal.cursor.visible = SDL_TRUE;
+                VTermRect rect = {
+                    .start_row = terminal.cursor.cell.y, .end_row = terminal.cursor.cell.y + 1,
+                    .start_col = terminal.cursor.cell.x, .end_col = terminal.cursor.cell.x + 1
+                };
+                damage_terminal_rect(rect);
+                if (configuration.cursor.interval > 0) {
+                    schedule_timer(TIMER_CURSOR, terminal.ticks + configuration.cursor.interval);
+                }
+            }
+            /* The window system may have discarded the window contents */
+            terminal.dirty = SDL_TRUE;
             break;
 
         case SDL_WINDOWEVENT_FOCUS_LOST:
@@ -976,11 +2694,40 @@ static void handle_keyboard_event(SDL_Keycode sym) {
         terminal.keyboard[SDL_SCANCODE_RCTRL]
     );
 
+    SDL_bool shift_pressed = (
+        terminal.keyboard[SDL_SCANCODE_LSHIFT] or
+        terminal.keyboard[SDL_SCANCODE_RSHIFT]
+    );
+
+    if (sym == SDLK_ESCAPE and terminal.paste.data != NULL) {
+        finish_terminal_paste();
+        return;
+    }
+
+    /* Ctrl-Shift-S exports the scrollback buffer to a file */
+    if (ctrl_pressed and shift_pressed and sym == SDLK_s) {
+        start_terminal_export();
+        return;
+    }
+
+    /* Ctrl-Shift-F starts a scrollback search or jumps to the previous match */
+    if (ctrl_pressed and shift_pressed and sym == SDLK_f) {
+        if (terminal.search.active) {
+            find_terminal_search(terminal.search.line - 1, SDL_TRUE);
+        } else {
+            open_terminal_search();
+        }
+        return;
+    } else if (terminal.search.active) {
+        handle_search_key(sym, shift_pressed);
+        return;
+    }
+
     if (ctrl_pressed) {
 		int mod = SDL_toupper(sym);
 		if(mod >= 'A' && mod <= 'Z') {
 			char ch = mod - 'A' + 1;
-			write(terminal.process.fd, &ch, sizeof(ch));
+			send_terminal_input(&ch, sizeof(ch));
 			return;
 		}
 	}
@@ -1099,10 +2846,265 @@ static void handle_keyboard_event(SDL_Keycode sym) {
 	}
 
 	if (input != NULL) {
-		write(terminal.process.fd, input, SDL_strlen(input));
+		send_terminal_input(input, SDL_strlen(input));
 	}
 }
 
+/**
+ * Returns the selection point of the cell at the given window coordinates,
+ * clamped to the rows and columns of the view
+ */
+static struct TerminalPoint terminal_point_at(int x, int y) {
+    int row = SDL_min(map_to_row(SDL_max(y - terminal.history.pixels, 0)), terminal.rows - 1);
+    struct TerminalAnchor anchor = terminal.history.top;
+    for (; row > 0; row--) {
+        if (not next_terminal_row(&anchor)) {
+            break;
+        }
+    }
+    struct TerminalPoint point;
+    point.cell = SDL_min(map_to_col(SDL_max(x, 0)), terminal.cols - 1);
+    if (anchor.line < history_length(terminal.history.lines)) {
+        const struct HistoryLine *line = history_get(terminal.history.lines, anchor.line);
+        point.line = anchor.line;
+        point.cell += history_line_wrap(line, terminal.cols, anchor.row);
+    } else {
+        point.line = anchor.line + anchor.row;
+    }
+    return point;
+}
+
+/**
+ * Renders the view again after the selection changed. Only cells whose
+ * highlight changed are drawn, the others still match the cell cache.
+ */
+static void render_terminal_selection(void) {
+    terminal.history.above.line = (size_t)-1;
+    render_terminal_view(0, terminal.rows);
+    if (not terminal_scrolled_back() and terminal.cursor.visible) {
+        render_terminal_cursor(SDL_TRUE);
+    }
+}
+
+/**
+ * Starts a selection at the cell under the mouse
+ */
+static void start_terminal_selection(void) {
+    struct MouseState *mouse = &terminal.mouse;
+    mouse->lmb = SDL_TRUE;
+    mouse->start = mouse->end = terminal_point_at(mouse->position.x, mouse->position.y);
+    /* Keep receiving motion while dragged outside of the window */
+    SDL_CaptureMouse(SDL_TRUE);
+    render_terminal_selection();
+}
+
+/**
+ * Moves the end of the selection to the cell under the mouse. Once dragged
+ * past the top or bottom of the window, the view starts scrolling on its own.
+ */
+static void drag_terminal_selection(void) {
+    struct MouseState *mouse = &terminal.mouse;
+    struct TerminalPoint end = terminal_point_at(mouse->position.x, mouse->position.y);
+    if (compare_terminal_points(end, mouse->end) != 0) {
+        mouse->end = end;
+        render_terminal_selection();
+    }
+    SDL_bool outside = mouse->position.y < 0 or mouse->position.y >= map_to_y(terminal.rows);
+    if (outside and terminal.scheduler.position[TIMER_SELECT] == 0) {
+        schedule_timer(TIMER_SELECT, terminal.ticks + SDLTERM_SELECT_INTERVAL);
+    }
+}
+
+/**
+ * Scrolls the view one step while the selection is dragged past the top or
+ * bottom of the window, by more rows the farther away the mouse is. The end
+ * of the selection follows once the scrolling is rendered.
+ */
+static void scroll_terminal_selection(void) {
+    struct MouseState *mouse = &terminal.mouse;
+    int bottom = map_to_y(terminal.rows);
+    int distance = 0;
+    if (mouse->position.y < 0) {
+        distance = mouse->position.y;
+    } else if (mouse->position.y >= bottom) {
+        distance = mouse->position.y - bottom + 1;
+    }
+    if (not mouse->lmb or distance == 0) {
+        return;
+    }
+    int rows = SDL_min(1 + SDL_abs(distance) / map_to_y(1), terminal.rows);
+    terminal.history.scroll += (distance < 0 ? rows : -rows) * map_to_y(1);
+    schedule_timer(TIMER_SELECT, terminal.ticks + SDLTERM_SELECT_INTERVAL);
+}
+
+/**
+ * Appends text to the selection being copied
+ */
+static void copy_terminal_text(const char *text, size_t length) {
+    struct MouseState *mouse = &terminal.mouse;
+    if (mouse->length + length > mouse->capacity) {
+        mouse->capacity = SDL_max(mouse->capacity * 2, mouse->length + length);
+        mouse->text = SDL_realloc(mouse->text, mouse->capacity);
+    }
+    SDL_memcpy(mouse->text + mouse->length, text, length);
+    mouse->length += length;
+}
+
+/**
+ * Appends the text of the cells from first to last. Erased cells are only
+ * copied as spaces once a character follows them, so that copied lines do
+ * not end in them; padding counts the ones still pending.
+ */
+static void copy_terminal_cells(const VTermScreenCell *cells, int first, int last, int *padding) {
+    for (int col = first; col <= last; col++) {
+        const VTermScreenCell *cell = &cells[col];
+        if (cell->chars[0] == 0) {
+            (*padding)++;
+            continue;
+        } else if (cell->chars[0] == (uint32_t)-1) {
+            /* Second half of a wide character */
+            continue;
+        }
+        for (; *padding > 0; (*padding)--) {
+            copy_terminal_text(" ", 1);
+        }
+        char bytes[VTERM_MAX_CHARS_PER_CELL * 4];
+        int length = 0;
+        for (int i = 0; i < VTERM_MAX_CHARS_PER_CELL and cell->chars[i] != 0; i++) {
+            length += history_encode_char(cell->chars[i], &bytes[length]);
+        }
+        copy_terminal_text(bytes, length);
+    }
+}
+
+/**
+ * Copies the selected text to the clipboard, built in a single pass over the
+ * selected lines. Scrollback lines selected as a whole are copied from their
+ * stored text, only the lines the selection starts or ends in are decoded.
+ * Screen rows continuing the line above are joined to it.
+ */
+static void copy_terminal_selection(void) {
+    struct MouseState *mouse = &terminal.mouse;
+    struct TerminalPoint from = mouse->start, to = mouse->end;
+    if (compare_terminal_points(from, to) > 0) {
+        from = mouse->end;
+        to = mouse->start;
+    }
+    size_t length = history_length(terminal.history.lines);
+    size_t total = length + terminal.rows;
+    if (to.line >= total) {
+        /* The screen got shorter during the selection */
+        to.line = total - 1;
+        to.cell = terminal.cols - 1;
+    }
+    mouse->length = 0;
+    int padding = 0;
+    for (size_t line = from.line; line <= to.line; line++) {
+        int first = line == from.line ? from.cell : 0;
+        int last = line == to.line ? to.cell : SDL_MAX_SINT32;
+        if (line < length) {
+            const struct HistoryLine *entry = history_get(terminal.history.lines, line);
+            int cells = history_line_cells(entry);
+            if (first == 0 and last >= cells - 1) {
+                size_t size;
+                const char *text = history_line_text(entry, &size);
+                copy_terminal_text(text, size);
+            } else {
+                VTermScreenCell *decoded = decode_terminal_line(line);
+                copy_terminal_cells(decoded, first, SDL_min(last, cells - 1), &padding);
+            }
+        } else {
+            VTermScreenCell *row = fetch_terminal_row(line - length);
+            copy_terminal_cells(row, first, SDL_min(last, terminal.cols - 1), &padding);
+        }
+        SDL_bool joined = (
+            line + 1 >= length and line + 1 < total and
+            vterm_state_get_lineinfo(terminal.state, line + 1 - length)->continuation
+        );
+        if (line < to.line and not joined) {
+            copy_terminal_text("\n", 1);
+            padding = 0;
+        }
+    }
+    copy_terminal_text("", 1);
+    SDL_SetClipboardText(mouse->text);
+    SDL_free(mouse->text);
+    mouse->text = NULL;
+    mouse->capacity = 0;
+}
+
+/**
+ * Ends the selection and copies it, unless the mouse was merely clicked
+ */
+static void finish_terminal_selection(void) {
+    struct MouseState *mouse = &terminal.mouse;
+    cancel_timer(TIMER_SELECT);
+    SDL_CaptureMouse(SDL_FALSE);
+    if (compare_terminal_points(mouse->start, mouse->end) != 0) {
+        copy_terminal_selection();
+    }
+    mouse->lmb = SDL_FALSE;
+    render_terminal_selection();
+}
+
+/**
+ * Feeds available output of the terminal child process to libvterm. While
+ * output floods in it keeps parsing until the next frame is due instead of
+ * rendering every intermediate state. Returns SDL_TRUE if any output was
+ * read, i.e. more output may be pending.
+ */
+static SDL_bool read_terminal_process(void) {
+    SDL_bool pending = SDL_FALSE;
+    do {
+        const char *data = NULL;
+        ssize_t length;
+        if (terminal.process.uring != NULL) {
+            length = uring_read(terminal.process.uring, &data);
+        } else {
+            static char buffer[4096];
+            length = read(terminal.process.fd, buffer, sizeof(buffer));
+            data = buffer;
+        }
+        if (length <= 0) {
+            break;
+        }
+        pending = SDL_TRUE;
+        terminal.frame.bytes += length;
+        stamp_terminal_read();
+        vterm_input_write(terminal.vterm, data, (size_t)length);
+        /* Send query replies generated by this batch of output */
+        flush_terminal_process();
+    } while (terminal_flooded() and not terminal_frame_due());
+    return pending;
+}
+
+/**
+ * Feeds the output the exited terminal child process left in the pseudo
+ * terminal to libvterm and reaps the child. Draining stops once the pty
+ * has no more data or after 100 ms, in case a leftover background process
+ * keeps writing.
+ */
+static void drain_terminal_process(void) {
+    Uint32 deadline = SDL_GetTicks() + 100;
+    while (not SDL_TICKS_PASSED(SDL_GetTicks(), deadline)) {
+        if (not read_terminal_process()) {
+            struct pollfd pollfd = { .fd = terminal.process.fd, .events = POLLIN };
+            if (terminal.process.uring != NULL) {
+                pollfd.fd = uring_fd(terminal.process.uring);
+            }
+            if (poll(&pollfd, 1, 10) <= 0 or not (pollfd.revents & POLLIN)) {
+                break;
+            }
+        }
+    }
+    int wstatus;
+    if (waitpid(terminal.process.pid, &wstatus, WNOHANG) == terminal.process.pid) {
+        SDL_LogDebug(0, "Child process exited with status %d", WEXITSTATUS(wstatus));
+    }
+    terminal.process.running = SDL_FALSE;
+    terminal.process.pending = SDL_FALSE;
+}
+
 /**
  * Updates the terminal emulator window and handles all events.
  */
@@ -1110,25 +3112,31 @@ static SDL_bool update_terminal_emulator(void) {
     SDL_bool keep_running = SDL_TRUE;
     SDL_Event event;
 
-    /* Terminal child process events */
-    if (terminal.process.running) {
-        /* Terminal child process output processing */
-        static char buffer[4096];
-        ssize_t length = read(terminal.process.fd, buffer, sizeof(buffer)-1);
-        if (length > 0) {
-            vterm_input_write(terminal.vterm, buffer, (size_t)length);
-        }
-        if (terminal.batch.flush) {
-            terminal.batch.flush = SDL_FALSE;
-            render_terminal_rect(&terminal.batch.rect);
-        }
+    /* Sleep until an SDL event, the terminal child process or the next
+     * deadline wakes us up. Without a watcher thread the child process is
+     * polled every window.timeout milliseconds instead. */
+    int timeout = next_timer_timeout();
+    if (terminal.process.pending or (terminal.paste.data != NULL and terminal_paste_space() > 0)) {
+        timeout = 0;
+    } else if (terminal.watcher.thread != NULL) {
+        arm_terminal_watcher();
+    } else if (timeout < 0 or timeout > configuration.window.timeout) {
+        timeout = configuration.window.timeout;
+    }
+    SDL_bool received;
+    if (timeout < 0) {
+        received = SDL_WaitEvent(&event);
+    } else if (timeout > 0) {
+        received = SDL_WaitEventTimeout(&event, timeout);
     } else {
-        event.type = SDL_QUIT;
-        SDL_PushEvent(&event);
+        received = SDL_PollEvent(&event);
     }
 
+    /* Update global CPU tick timer */
+    terminal.ticks = SDL_GetTicks();
+
     /* SDL events */
-    while (SDL_WaitEventTimeout(&event, configuration.window.timeout)) {
+    for (; received; received = SDL_PollEvent(&event)) {
         switch (event.type) {
             default:
                 /* Unhandled event */
@@ -1148,9 +3156,9 @@ static SDL_bool update_terminal_emulator(void) {
 
             case SDL_MOUSEBUTTONDOWN:
                 if (event.button.button == 1) {
-                    terminal.mouse.lmb = SDL_TRUE;
-                    terminal.mouse.rect.start_row = terminal.mouse.rect.end_row = terminal.mouse.cell.row;
-                    terminal.mouse.rect.start_col = terminal.mouse.rect.end_col = terminal.mouse.cell.col;
+                    terminal.mouse.position.x = event.button.x;
+                    terminal.mouse.position.y = event.button.y;
+                    start_terminal_selection();
                 } else if (event.button.button == 2) {
                     terminal.mouse.mmb = SDL_TRUE;
                 } else if (event.button.button == 3) {
@@ -1159,22 +3167,13 @@ static SDL_bool update_terminal_emulator(void) {
                 break;
 
             case SDL_MOUSEBUTTONUP:
-                if (event.button.button == 1) {
-                    terminal.mouse.lmb = SDL_FALSE;
-                    highlight_cells(terminal.mouse.rect, SDL_FALSE);
-                    size_t length = vterm_screen_get_text(terminal.screen, NULL, 0, terminal.mouse.rect);
-                    char *buffer = SDL_malloc(length);
-                    vterm_screen_get_text(terminal.screen, buffer, length, terminal.mouse.rect);
-                    SDL_SetClipboardText(buffer);
-                    SDL_free(buffer);
-
+                if (event.button.button == 1 and terminal.mouse.lmb) {
+                    finish_terminal_selection();
                 } else if (event.button.button == 2) {
                     terminal.mouse.mmb = SDL_FALSE;
                 } else if (event.button.button == 3) {
                     terminal.mouse.rmb = SDL_FALSE;
-                    char *buffer = SDL_GetClipboardText();
-                    write(terminal.process.fd, buffer, SDL_strlen(buffer));
-                    SDL_free(buffer);
+                    start_terminal_paste();
                 }
                 break;
 
@@ -1184,69 +3183,164 @@ static SDL_bool update_terminal_emulator(void) {
                 terminal.mouse.cell.col = map_to_col(event.motion.x);
                 terminal.mouse.cell.row = map_to_row(event.motion.y);
                 if (terminal.mouse.lmb) {
-                    highlight_cells(terminal.mouse.rect, SDL_FALSE);
-                    if (terminal.mouse.cell.row > terminal.mouse.rect.start_row) {
-                        terminal.mouse.rect.end_row = terminal.mouse.cell.row;
-                    } else {
-                        terminal.mouse.rect.start_row = terminal.mouse.cell.row;
-                    }
-                    if (terminal.mouse.cell.col > terminal.mouse.rect.start_col) {
-                        terminal.mouse.rect.end_col = terminal.mouse.cell.col;
-                    } else {
-                        terminal.mouse.rect.start_col = terminal.mouse.cell.col;
-                    }
-                    highlight_cells(terminal.mouse.rect, SDL_TRUE);
+                    drag_terminal_selection();
                 }
                 break;
 
             case SDL_MOUSEWHEEL:
-                if (
-                    (event.wheel.y > 0 and terminal.history.offset < terminal.history.length) or
-                    (event.wheel.y < 0 and terminal.history.offset > 0)
-                ) {
-                    terminal.history.offset += event.wheel.y;
-                }
-                render_terminal_history();
+                /* Scrolls by pixels, applied once per frame below */
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+                terminal.history.scroll += event.wheel.preciseY * map_to_y(1);
+#else
+                terminal.history.scroll += event.wheel.y * map_to_y(1);
+#endif
                 break;
 
             case SDL_TEXTINPUT:
-                write(terminal.process.fd, event.edit.text, SDL_strlen(event.edit.text));
+                if (terminal.search.active) {
+                    append_terminal_search(event.text.text);
+                    break;
+                }
+                send_terminal_input(event.text.text, SDL_strlen(event.text.text));
                 break;
         }
     }
 
-    /* Update global CPU tick timer */
-    terminal.ticks = SDL_GetTicks();
+    /* Terminal child process output processing */
+    if (terminal.process.running) {
+        if (terminal_process_exited()) {
+            drain_terminal_process();
+            event.type = SDL_QUIT;
+            SDL_PushEvent(&event);
+        } else {
+            terminal.process.pending = read_terminal_process();
+        }
+    }
+
+    /* Stream pending paste data */
+    update_terminal_paste();
+
+    /* Send queued input to the terminal child process */
+    flush_terminal_process();
+
+    /* Expired deadlines */
+    for (int timer; (timer = expire_timer(terminal.ticks)) >= 0;) {
+        switch (timer) {
+            default:
+                /* Frame and synchronized update deadlines only wake up the
+                 * loop, rendering below checks them itself */
+                break;
+
+            case TIMER_CURSOR:
+                /* The cursor is not drawn over a scrolled back view */
+                terminal.cursor.visible = !terminal.cursor.visible;
+                if (not terminal_scrolled_back()) {
+                    render_terminal_cursor(terminal.cursor.visible);
+                }
+                schedule_timer(TIMER_CURSOR, terminal.ticks + configuration.cursor.interval);
+                break;
+
+            case TIMER_BELL:
+                terminal.bell.active = SDL_FALSE;
+                terminal.dirty = SDL_TRUE;
+                break;
+
+            case TIMER_SELECT:
+                scroll_terminal_selection();
+                break;
+
+            case TIMER_RESIZE: {
+                /* Only cells that changed (reflowed or newly exposed) are
+                 * rendered again, the rest is kept from the old texture */
+                terminal.cols = map_to_col(terminal.width);
+                terminal.rows = map_to_row(terminal.height);
+                terminal.ticks_resize = terminal.ticks;
+                resize_terminal_texture();
+                resize_terminal_cache();
+                struct winsize winsize = {
+                    .ws_col = terminal.cols,
+                    .ws_row = terminal.rows,
+                    .ws_xpixel = terminal.width,
+                    .ws_ypixel = terminal.height
+                };
+                ioctl(terminal.process.fd, TIOCSWINSZ, &winsize);
+                vterm_set_size(terminal.vterm, terminal.rows, terminal.cols);
+                if (terminal_scrolled_back()) {
+                    render_terminal_history();
+                } else {
+                    render_terminal_screen();
+                }
+                break;
+            }
+        }
+    }
 
-    /* Apply resize event */
-    if (terminal.ticks_resize > 0 and terminal.ticks - terminal.ticks_resize > 500) {
-        struct winsize winsize = {
-            .ws_col = terminal.cols,
-            .ws_row = terminal.rows,
-            .ws_xpixel = terminal.width,
-            .ws_ypixel = terminal.height
-        };
-        ioctl(terminal.process.fd, TIOCSWINSZ, &winsize);
-        vterm_set_size(terminal.vterm, terminal.rows, terminal.cols);
-        clear_terminal_window();
-        render_terminal_screen();
-        terminal.ticks_resize = 0;
-    }
-
-    /* Update terminal cell cursor */
-    if (terminal.ticks - terminal.cursor.ticks > configuration.cursor.interval) {
-        terminal.cursor.ticks = terminal.ticks;
-        if (configuration.cursor.interval > 0) {
-            terminal.cursor.visible = !terminal.cursor.visible;
-            render_terminal_cursor(terminal.cursor.visible);
+    /* Render pending damage; while output floods in, intermediate states
+     * are skipped and only the state at the frame deadline is rendered.
+     * Nothing is rendered while the application synchronizes an update,
+     * while the window is hidden or while the view is scrolled back, the
+     * damage is caught up on afterwards. */
+    SDL_bool synchronized = terminal_synchronized();
+    if (synchronized) {
+        /* Keep accumulating damage */
+    } else if (terminal_frame_due()) {
+        if (terminal_scroll_pending() and not terminal.hidden) {
+            render_terminal_scroll();
+            if (terminal.mouse.lmb) {
+                /* The view moved under the mouse */
+                drag_terminal_selection();
+            }
+        }
+        if (terminal.batch.flush and not terminal.hidden and not terminal_scrolled_back()) {
+            render_terminal_damage();
         }
+        terminal.frame.ticks = terminal.ticks;
+        terminal.frame.bytes = 0;
+    } else if (
+        terminal.batch.flush and not terminal.hidden and not terminal_scrolled_back() and
+        not terminal_flooded()
+    ) {
+        render_terminal_damage();
+    }
+    SDL_bool pending = (terminal.batch.flush and not terminal_scrolled_back()) or terminal_scroll_pending();
+    if (pending and not synchronized and not terminal.hidden) {
+        schedule_timer(TIMER_FRAME, terminal.frame.ticks + terminal.frame.interval);
+    }
+
+    /* Print statistics on SIGUSR1 */
+    if (terminal.statistics) {
+        terminal.statistics = 0;
+        print_terminal_statistics();
+    }
+
+    /* Export the scrollback buffer on SIGUSR2 and collect finished exports */
+    if (terminal.export.requested) {
+        terminal.export.requested = 0;
+        start_terminal_export();
+    }
+    if (terminal.export.job != NULL and export_done(terminal.export.job)) {
+        finish_terminal_export();
     }
 
-    /* Trigger screen refresh */
-    if (terminal.dirty) {
-        SDL_RenderPresent(terminal.renderer);
-        terminal.dirty = SDL_FALSE;
-        SDL_LogDebug(0, "Epoch %d\n", terminal.ticks);
+    /* Trigger screen refresh; presents are paced to the frame interval and
+     * everything rendered in between is coalesced into the next one */
+    if (terminal.dirty and not synchronized and not terminal.hidden) {
+        struct TerminalPresent *present = &terminal.present;
+        if (not present->pending) {
+            Uint32 due = present->ticks + terminal.frame.interval;
+            present->due = SDL_TICKS_PASSED(terminal.ticks, due) ? terminal.ticks : due;
+            present->pending = SDL_TRUE;
+        }
+        if (SDL_TICKS_PASSED(terminal.ticks, present->due)) {
+            render_terminal_above();
+            present_terminal_window();
+            stamp_terminal_present();
+            count_terminal_present();
+            terminal.dirty = SDL_FALSE;
+            SDL_LogDebug(0, "Epoch %d\n", terminal.ticks);
+        } else {
+            schedule_timer(TIMER_FRAME, present->due);
+        }
     }
 
     return keep_running;
@@ -1261,6 +3355,9 @@ int main(int argc, char *argv[]) {
     load_sdlterm_configuration_file();
     open_terminal_emulator();
     while (update_terminal_emulator());
+    if (configuration.logging.statistics) {
+        print_terminal_statistics();
+    }
     close_terminal_emulator();
     free_sdlterm_configuration();
     return 0;
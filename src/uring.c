@@ -0,0 +1,293 @@
+#include <SDL2/SDL.h>
+#include <iso646.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "uring.h"
+
+enum {
+    URING_READ = 1,
+    URING_WRITE,
+    URING_CANCEL
+};
+
+struct Uring {
+    int fd;
+    int ring_fd;
+
+    /* Submission queue */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned  sq_entries;
+    struct io_uring_sqe *sqes;
+
+    /* Completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* Mappings */
+    void  *sq_ptr;
+    size_t sq_size;
+    void  *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+
+    /* Read state */
+    char    *buffers[2];
+    size_t   buffer_size;
+    SDL_bool fixed;
+    SDL_bool reading;
+    int      buffer;
+    SDL_bool completed;
+    int      result;
+
+    /* Write state */
+    SDL_bool writing;
+    ssize_t  written;
+};
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int ring_fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static struct io_uring_sqe* get_sqe(struct Uring *ring) {
+    unsigned tail = *ring->sq_tail;
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    SDL_memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+static SDL_bool submit(struct Uring *ring) {
+    int result;
+    do {
+        result = io_uring_enter(ring->ring_fd, 1, 0, 0);
+    } while (result < 0 and errno == EINTR);
+    return result >= 0;
+}
+
+static SDL_bool submit_read(struct Uring *ring, int buffer) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (sqe == NULL) {
+        return SDL_FALSE;
+    }
+    sqe->opcode = ring->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = ring->fd;
+    sqe->addr = (Uint64)(uintptr_t)ring->buffers[buffer];
+    sqe->len = ring->buffer_size;
+    sqe->off = (Uint64)-1;
+    sqe->buf_index = buffer;
+    sqe->user_data = URING_READ;
+    ring->buffer = buffer;
+    ring->reading = submit(ring);
+    return ring->reading;
+}
+
+static void reap_completions(struct Uring *ring) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        switch (cqe->user_data) {
+            default:
+                break;
+
+            case URING_READ:
+                ring->reading = SDL_FALSE;
+                ring->completed = SDL_TRUE;
+                ring->result = cqe->res;
+                break;
+
+            case URING_WRITE:
+                ring->writing = SDL_FALSE;
+                if (cqe->res < 0) {
+                    ring->written = -1;
+                } else if (ring->written >= 0) {
+                    ring->written += cqe->res;
+                }
+                break;
+        }
+        head++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+struct Uring* uring_open(int fd, size_t buffer_size) {
+    struct io_uring_params params;
+    SDL_zero(params);
+    int ring_fd = io_uring_setup(8, &params);
+    if (ring_fd < 0) {
+        SDL_SetError("io_uring_setup: %s", strerror(errno));
+        return NULL;
+    }
+
+    struct Uring *ring = SDL_calloc(1, sizeof(*ring));
+    ring->fd = fd;
+    ring->ring_fd = ring_fd;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_size = ring->cq_size = SDL_max(ring->sq_size, ring->cq_size);
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        goto failure;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            goto failure;
+        }
+    }
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto failure;
+    }
+
+    ring->sq_head  = (unsigned*)((char*)ring->sq_ptr + params.sq_off.head);
+    ring->sq_tail  = (unsigned*)((char*)ring->sq_ptr + params.sq_off.tail);
+    ring->sq_mask  = (unsigned*)((char*)ring->sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)((char*)ring->sq_ptr + params.sq_off.array);
+    ring->cq_head  = (unsigned*)((char*)ring->cq_ptr + params.cq_off.head);
+    ring->cq_tail  = (unsigned*)((char*)ring->cq_ptr + params.cq_off.tail);
+    ring->cq_mask  = (unsigned*)((char*)ring->cq_ptr + params.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe*)((char*)ring->cq_ptr + params.cq_off.cqes);
+
+    /* Register both read buffers; without registration (e.g. due to a low
+     * RLIMIT_MEMLOCK) plain reads are used instead of fixed ones */
+    ring->buffer_size = buffer_size;
+    ring->buffers[0] = SDL_malloc(buffer_size * 2);
+    ring->buffers[1] = ring->buffers[0] + buffer_size;
+    struct iovec iovecs[2] = {
+        { .iov_base = ring->buffers[0], .iov_len = buffer_size },
+        { .iov_base = ring->buffers[1], .iov_len = buffer_size }
+    };
+    ring->fixed = io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, iovecs, 2) == 0;
+
+    if (not submit_read(ring, 0)) {
+        goto failure;
+    }
+    return ring;
+
+failure:
+    SDL_SetError("io_uring: %s", strerror(errno));
+    uring_close(ring);
+    return NULL;
+}
+
+void uring_close(struct Uring *ring) {
+    if (ring->reading) {
+        struct io_uring_sqe *sqe = get_sqe(ring);
+        if (sqe != NULL) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = URING_READ;
+            sqe->user_data = URING_CANCEL;
+            submit(ring);
+        }
+    }
+    /* The kernel may still access the buffers until the requests complete */
+    while (ring->reading or ring->writing) {
+        if (io_uring_enter(ring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 and errno != EINTR) {
+            break;
+        }
+        reap_completions(ring);
+    }
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr != NULL and ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr != NULL) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    close(ring->ring_fd);
+    SDL_free(ring->buffers[0]);
+    SDL_free(ring);
+}
+
+int uring_fd(const struct Uring *ring) {
+    return ring->ring_fd;
+}
+
+ssize_t uring_read(struct Uring *ring, const char **data) {
+    reap_completions(ring);
+    if (not ring->completed) {
+        return 0;
+    }
+    ring->completed = SDL_FALSE;
+    int buffer = ring->buffer;
+    if (ring->result > 0) {
+        /* Keep the kernel busy with the other buffer while this one is
+         * consumed by the caller */
+        *data = ring->buffers[buffer];
+        submit_read(ring, !buffer);
+        return ring->result;
+    } else if (ring->result == -EAGAIN or ring->result == -EINTR) {
+        submit_read(ring, buffer);
+        return 0;
+    }
+    return -1;
+}
+
+SDL_bool uring_write(struct Uring *ring, const char *data, size_t length) {
+    if (ring->writing) {
+        return SDL_FALSE;
+    }
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (sqe == NULL) {
+        return SDL_FALSE;
+    }
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = ring->fd;
+    sqe->addr = (Uint64)(uintptr_t)data;
+    sqe->len = length;
+    sqe->off = (Uint64)-1;
+    sqe->user_data = URING_WRITE;
+    ring->writing = submit(ring);
+    return ring->writing;
+}
+
+SDL_bool uring_writing(struct Uring *ring) {
+    reap_completions(ring);
+    return ring->writing;
+}
+
+ssize_t uring_written(struct Uring *ring) {
+    reap_completions(ring);
+    ssize_t written = ring->written;
+    ring->written = 0;
+    return written;
+}
@@ -0,0 +1,57 @@
+#ifndef SDLTERM_URING_H
+#define SDLTERM_URING_H
+
+#include <SDL2/SDL.h>
+#include <sys/types.h>
+
+/**
+ * An io_uring based I/O engine for a single file descriptor. Reads go into
+ * two registered buffers, one of which is always in flight, writes are
+ * submitted from the caller's buffer.
+ */
+struct Uring;
+
+/**
+ * Sets up an io_uring instance for the given file descriptor and submits
+ * the first read. Returns NULL if io_uring is unavailable on this system.
+ * The file descriptor should be in blocking mode, otherwise the kernel
+ * completes reads with -EAGAIN instead of waiting for data.
+ */
+extern struct Uring* uring_open(int fd, size_t buffer_size);
+
+/**
+ * Cancels all requests in flight and frees the io_uring instance.
+ */
+extern void uring_close(struct Uring *ring);
+
+/**
+ * Returns the io_uring file descriptor, which polls readable whenever
+ * completions are pending.
+ */
+extern int uring_fd(const struct Uring *ring);
+
+/**
+ * Returns the data of a completed read, 0 if no read has completed or -1 if
+ * the file reached its end or failed. The next read is submitted right
+ * away; the returned data stays valid until the next call.
+ */
+extern ssize_t uring_read(struct Uring *ring, const char **data);
+
+/**
+ * Submits a write of the given data, which must stay untouched until the
+ * write completed. Returns SDL_FALSE if another write is still in flight.
+ */
+extern SDL_bool uring_write(struct Uring *ring, const char *data, size_t length);
+
+/**
+ * Returns SDL_TRUE while a write is in flight.
+ */
+extern SDL_bool uring_writing(struct Uring *ring);
+
+/**
+ * Returns the number of bytes transferred by writes completed since the
+ * last call or -1 if a write failed.
+ */
+extern ssize_t uring_written(struct Uring *ring);
+
+#endif /* SDLTERM_URING_H */
@@ -0,0 +1,114 @@
+/**
+ * Spills slabs of the scrollback buffer to disk before the compressor gets
+ * to them, lets it replace them by their compressed form afterwards and
+ * checks that the spill file does not keep the uncompressed ranges.
+ */
+#define _GNU_SOURCE
+#include <SDL2/SDL.h>
+#include <iso646.h>
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "../src/history.h"
+
+#define COLS 200
+#define LINES 200000
+
+/**
+ * Sets the scheduling policy of all threads but the calling one, i.e. of the
+ * compressor thread of the scrollback buffer
+ */
+static void schedule_other_threads(int policy) {
+    DIR *directory = opendir("/proc/self/task");
+    pid_t self = syscall(SYS_gettid);
+    struct sched_param param = {0};
+    for (struct dirent *entry; (entry = readdir(directory)) != NULL;) {
+        pid_t thread = atoi(entry->d_name);
+        if (thread > 0 and thread != self) {
+            sched_setscheduler(thread, policy, &param);
+        }
+    }
+    closedir(directory);
+}
+
+/**
+ * Returns the descriptor of the unlinked spill file or -1
+ */
+static int find_spill_file(void) {
+    DIR *directory = opendir("/proc/self/fd");
+    int fd = -1;
+    for (struct dirent *entry; (entry = readdir(directory)) != NULL;) {
+        char link[64], path[4096];
+        SDL_snprintf(link, sizeof(link), "/proc/self/fd/%s", entry->d_name);
+        ssize_t length = readlink(link, path, sizeof(path) - 1);
+        if (length > 0) {
+            path[length] = '\0';
+            if (strstr(path, "sdlterm-history-") != NULL) {
+                fd = atoi(entry->d_name);
+            }
+        }
+    }
+    closedir(directory);
+    return fd;
+}
+
+int main(void) {
+    struct History *history = history_create(0);
+    VTermScreenCell blank, row[COLS];
+    SDL_zero(blank);
+    blank.width = 1;
+
+    /* On a single CPU the idle compressor only runs once pushing is done, so
+     * the slabs are spilled uncompressed first */
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(0, &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+    schedule_other_threads(SCHED_IDLE);
+    srand(1);
+    for (int line = 0; line < LINES; line++) {
+        for (int col = 0; col < COLS; col++) {
+            row[col] = blank;
+            row[col].chars[0] = "0123456789abcdef"[rand() % 16];
+        }
+        history_push(history, row, COLS, &blank, SDL_FALSE);
+    }
+    schedule_other_threads(SCHED_OTHER);
+
+    /* Statistics apply the compressed slabs, all but the open one */
+    struct HistoryStatistics statistics;
+    for (int tries = 0; tries < 6000; tries++) {
+        history_statistics(history, &statistics);
+        if (statistics.compressed + 1 >= statistics.slabs) {
+            break;
+        }
+        usleep(10000);
+    }
+
+    int fd = find_spill_file();
+    struct stat file;
+    if (fd < 0 or fstat(fd, &file) != 0) {
+        fprintf(stderr, "no spill file\n");
+        return 1;
+    }
+    size_t allocated = (size_t)file.st_blocks * 512;
+    size_t slack = statistics.spilled * sysconf(_SC_PAGESIZE);
+    printf(
+        "spilled %zu compressed %zu stored %zu allocated %zu\n",
+        statistics.spilled, statistics.compressed, statistics.stored, allocated
+    );
+    history_destroy(history);
+    if (statistics.spilled == 0 or statistics.compressed + 1 < statistics.slabs) {
+        fprintf(stderr, "slabs were not spilled and compressed\n");
+        return 1;
+    } else if (allocated > statistics.stored + slack) {
+        fprintf(stderr, "spill file keeps %zu bytes too many\n", allocated - statistics.stored);
+        return 1;
+    }
+    return 0;
+}